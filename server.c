@@ -1,11 +1,14 @@
 
 #include <stdio.h>
 #include <stdlib.h>
+#include <stdbool.h>
 #include <string.h>
 #include <assert.h>
 #include <time.h>
+#include <stdatomic.h>
 
 #include <unistd.h>
+#include <pthread.h>
 
 #include <sys/types.h>
 #include <arpa/inet.h>
@@ -19,6 +22,13 @@
 #include "wdict.h"
 #include "wpos.h"
 #include "wsolve.h"
+#include "wmatrix.h"
+#include "wsession.h"
+#include "wcache.h"
+#include "wsuggest.h"
+#include "wbook.h"
+#include "wlog.h"
+#include "wmetrics.h"
 
 #define PORT                8888
 
@@ -30,7 +40,75 @@
 #define MAIN_SOLVER_URL     "/wordle/solver"
 #define SOLVER_API_URL      "/wordle/solver/solve"
 
+#define METRICS_URL         "/wordle/metrics"
+
 #define JSON_DATA           "application/json"
+#define METRICS_DATA        "text/plain; version=0.0.4"
+
+// all allocations made for a request, including the response, are done in
+// an arena of REQUEST_ARENA_SIZE bytes, which is enough for the full
+// dictionary span and its response in most cases. More is allocated on the
+// heap if needed (see warena.h).
+#define REQUEST_ARENA_SIZE  (64 * 1024)
+
+// Requests are answered by a pool of threads (a single thread by default).
+// Each thread owns the data needed to answer a request, which is taken from
+// an array preallocated for all threads, the first time the thread answers a
+// request. Each request gets an arena from the thread, in which its response
+// is built and given as is to microhttpd. The arena is given back to the
+// thread when microhttpd has sent the response and completed the request,
+// which happens in the thread answering the request, so that no lock is
+// needed. A thread may serve several connections at the same time: it keeps
+// as many arenas as it has requests in progress.
+typedef struct _server_worker server_worker;
+
+typedef struct _server_request {
+    arena                   a;
+    struct _server_request  *next;  // in the worker list of free requests
+    server_worker           *sw;
+} server_request;
+
+struct _server_worker {
+    solver_data     sd;
+    server_request  *free;          // requests completed, to reuse
+    uint64_t        random;         // xorshift64 state, never 0
+};
+
+static _Thread_local server_worker *t_worker;
+
+static server_request *get_request( server_worker *sw )
+{
+    server_request *sr = sw->free;
+    if ( NULL != sr ) {
+        sw->free = sr->next;
+    } else {
+        sr = malloc( sizeof( server_request ) );
+        if ( NULL == sr ) {
+            printf( "server: could not allocate memory for request - exiting\n" );
+            exit(1);
+        }
+        init_arena( &sr->a, REQUEST_ARENA_SIZE );
+        sr->sw = sw;
+    }
+    return sr;
+}
+
+static void release_request( server_request *sr )
+{
+    reset_arena( &sr->a );
+    sr->next = sr->sw->free;
+    sr->sw->free = sr;
+}
+
+static uint32_t get_random( server_worker *sw )
+{
+    uint64_t x = sw->random;
+    x ^= x << 13;
+    x ^= x >> 7;
+    x ^= x << 17;
+    sw->random = x;
+    return (uint32_t)( ( x * 0x2545F4914F6CDD1Dull ) >> 32 );
+}
 
 #if MHD_VERSION < 0x00097002
 #define eMHD_Result  int
@@ -44,6 +122,9 @@ static eMHD_Result on_client_connect( void *cls, const struct sockaddr *addr,
     (void)cls;
     (void)addrlen;
 
+    if ( ! is_log_enabled( LOG_INFO ) ) {
+        return MHD_YES;
+    }
     if ( addr->sa_family == AF_INET ) {
 
         const unsigned char *p = (unsigned char *)&addr->sa_data[0];
@@ -52,12 +133,12 @@ static eMHD_Result on_client_connect( void *cls, const struct sockaddr *addr,
 
         char ip4[INET_ADDRSTRLEN];  // space to hold the IPv4 string
         inet_ntop(AF_INET, &(addr->sa_data[2]), ip4, INET_ADDRSTRLEN);
-        printf( "IPv4 Address: %s:%u\n", ip4, (uint16_t)(*p<<8) + (uint16_t)(*(p+1)) );
+        log_message( LOG_INFO, "IPv4 Address: %s:%u", ip4, (uint16_t)(*p<<8) + (uint16_t)(*(p+1)) );
     } else if ( addr->sa_family == AF_INET6 ) {
         const unsigned char *p = (unsigned char *)&addr->sa_data[0];
         char ip6[INET6_ADDRSTRLEN]; // space to hold the IPv6 string
         inet_ntop(AF_INET6, &(addr->sa_data[2]), ip6, INET6_ADDRSTRLEN);
-        printf( "IPv6 Address: %s:%u\n", ip6, (uint16_t)(*p<<8) + (uint16_t)(*(p+1)) );
+        log_message( LOG_INFO, "IPv6 Address: %s:%u", ip6, (uint16_t)(*p<<8) + (uint16_t)(*(p+1)) );
     }
     return MHD_YES;
 }
@@ -67,7 +148,7 @@ static eMHD_Result check_headers( void *cls, enum MHD_ValueKind kind,
 {
     (void)cls;
     (void)kind;
-    printf( "%s: %s\n", key, value );
+    log_message( LOG_DEBUG, "%s: %s", key, value );
     return MHD_YES;
 }
 
@@ -76,7 +157,7 @@ static int get_int_value( const char *value )
     char *end = NULL;
     int val = (int)strtol( value, &end, 10 );
     if ( end != NULL && 0 != *end ) {
-        printf( "Garbage after integer number: <%s>\n", end );
+        log_message( LOG_WARNING, "Garbage after integer number: <%s>", end );
     }
     return val;
 }
@@ -85,6 +166,7 @@ typedef struct {
     int     game;
     int     attempt;
     char    word[WORD_SIZE+1];
+    bool    trace;          // log debug messages for this request
 } play_parameters;
 
 static eMHD_Result get_player_query( void *cls, enum MHD_ValueKind kind,
@@ -93,7 +175,9 @@ static eMHD_Result get_player_query( void *cls, enum MHD_ValueKind kind,
     (void)kind;
     play_parameters *params = cls;
     assert( params );
-    printf( "player query: %s=%s\n", key, value );
+    if ( params->trace ) {
+        log_message( LOG_DEBUG, "player query: %s=%s", key, value );
+    }
     if ( 0 == strcmp( key, "game" ) ) {
         params->game = get_int_value( value );
     } else if ( 0 == strcmp( key, "attempt" ) ) {
@@ -108,52 +192,86 @@ static eMHD_Result get_player_query( void *cls, enum MHD_ValueKind kind,
     return MHD_YES;
 }
 
+typedef struct {
+    arena   *a;                                 // of the request
+    char    *data;
+    char    session[MAX_SESSION_ID_SIZE+1];     // empty if no session
+    int     k;                                  // number of suggestions
+    suggest_strategy strategy;
+    char    *unknown_strategy;                  // as given, NULL if known
+    bool    trace;                              // log debug messages
+} solve_parameters;
+
 static eMHD_Result get_solver_query( void *cls, enum MHD_ValueKind kind,
                                     const char *key, const char *value )
 {
     (void)kind;
-    char **data_ptr = cls;
-    printf( "solver query: %s=%s\n", key, value );
+    solve_parameters *params = cls;
+    assert( params );
+    if ( params->trace ) {
+        log_message( LOG_DEBUG, "solver query: %s=%s", key, value );
+    }
     if ( 0 == strcmp( key, "data" ) ) {
-        int size = strlen( value ) + 1;
-        char *buffer = malloc( size );
-        if ( NULL != buffer ) {
-            strcpy( buffer, value );
-            *data_ptr = buffer;
+        // in case of multiple data, the last one is used
+        size_t size = strlen( value ) + 1;
+        params->data = arena_alloc( params->a, size );
+        memcpy( params->data, value, size );
+    } else if ( 0 == strcmp( key, "k" ) ) {
+        params->k = get_int_value( value );
+        if ( params->k < 1 ) {
+            params->k = 1;
+        } else if ( params->k > MAX_SUGGESTIONS ) {
+            params->k = MAX_SUGGESTIONS;
+        }
+    } else if ( 0 == strcmp( key, "strategy" ) ) {
+        // in case of multiple strategies, the last one is used
+        params->unknown_strategy = NULL;
+        if ( ! get_strategy_from_name( value, &params->strategy ) ) {
+            log_message( LOG_WARNING, "Unknown strategy: <%s>", value );
+            size_t size = strlen( value ) + 1;
+            params->unknown_strategy = arena_alloc( params->a, size );
+            memcpy( params->unknown_strategy, value, size );
+        }
+    } else if ( 0 == strcmp( key, "session" ) ) {
+        int l = strnlen( value, MAX_SESSION_ID_SIZE+1 );
+        if ( l <= MAX_SESSION_ID_SIZE ) {
+            memcpy( params->session, value, l );
+            params->session[l] = 0;
         }
-    }   
+    }
     return MHD_YES;
 }
 
-static int word_cmp( const void *p1, const void *p2 )
-{
-     return strcmp( * (char * const *) p1, * (char * const *) p2 );
-}
-
 #define ERROR_FORMAT     "{ \"error\": \"not in dictionary\", \"word\": \"slate\" }"
 #define FAIL_FORMAT      "{ \"error\": \"failed to solve\", \"word\": \"slate\" }"
 #define RESPONSE_FORMAT  "{ \"game\": 9999, \"word\": \"slate\", \"position\": \"--wrr\" }"
-static char * play( play_parameters *pp )
+static char * play( play_parameters *pp, server_worker *sw, arena *a )
 {
     char *buffer;
 
-    printf( "game=%d word=%s\n", pp->game, pp->word );
+    if ( pp->trace ) {
+        log_message( LOG_DEBUG, "game=%d word=%s", pp->game, pp->word );
+    }
     if ( ! is_word_in_dictionary( pp-> word ) ) {
-        buffer = malloc( sizeof( ERROR_FORMAT ) );
+        buffer = arena_alloc( a, sizeof( ERROR_FORMAT ) );
         snprintf( buffer, sizeof( ERROR_FORMAT ),
                   "{ \"error\": \"not in dictionary\", \"word\": \"%s\" }",
                    pp->word );
     } else {
         if ( -1 == pp->game ) {
             int n_words = get_dictionary_size();
-            pp->game = rand() % n_words;
-            printf( "Playing wordle - number %d\n", pp->game );
+            pp->game = get_random( sw ) % n_words;
+            if ( pp->trace ) {
+                log_message( LOG_DEBUG, "Playing wordle - number %d", pp->game );
+            }
         }
 
         const char *ref = get_nth_word_in_dictionary( pp->game );
-        printf("Reference: %s\n", ref );
+        if ( pp->trace ) {
+            log_message( LOG_DEBUG, "Reference: %s", ref );
+        }
         if ( MAX_TRIES-1 <= pp->attempt && strcmp( ref, pp->word ) ) {
-            buffer = malloc( sizeof( FAIL_FORMAT ) );
+            buffer = arena_alloc( a, sizeof( FAIL_FORMAT ) );
             snprintf( buffer, sizeof( FAIL_FORMAT ),
                       "{ \"error\": \"failed to solve\", \"word\": \"%s\" }",
                        ref );
@@ -161,23 +279,85 @@ static char * play( play_parameters *pp )
             char position[WORD_SIZE+1];
             get_position_from_words( ref, pp->word, position );
 
-            buffer = malloc( sizeof( RESPONSE_FORMAT ) );
+            buffer = arena_alloc( a, sizeof( RESPONSE_FORMAT ) );
             snprintf( buffer, sizeof( RESPONSE_FORMAT ),
                       "{ \"game\": %d, \"word\": \"%s\", \"position\": \"%s\" }",
                       pp->game, pp->word, position );
         }
     }
-    printf( "response:\n%s\n", buffer );
+    if ( pp->trace ) {
+        log_message( LOG_DEBUG, "response: %s", buffer );
+    }
     return buffer;
 }
 
 // assuming that all error msgs are less than 240 characters
 #define ERROR_MSG_SIZE  256
-#define EMPTY_RESPONSE  "{ \"suggest\": \"\", \"list\": [] }"
-static char * solve( char *data, solver_data *sd )
+#define EMPTY_RESPONSE  "{ \"suggest\": \"\", \"suggestions\": [], \"list\": [] }"
+// a suggestion is { "word": "slate", "entropy": 5.873, "expected": 71.578, "worst": 221 }
+// with up to 4 digits in entropy integer part, 6 in expected, 5 in worst.
+#define SUGGESTION_SIZE 96
+
+// return the response for the given solutions and suggestions. Solutions are
+// listed in dictionary order, which is alphabetical order.
+static char *get_solver_response( arena *a, const word_span *res,
+                                  const suggestion *best, int n_best )
 {
+    char *buffer;
+    if ( 0 == res->n_words ) {
+        buffer = arena_alloc( a, sizeof(EMPTY_RESPONSE) );
+        strcpy( buffer, EMPTY_RESPONSE );
+        return buffer;
+    }
+
+    size_t nw = res->n_words;
+    // evaluate high boundary for response: (WORD_SIZE + 4) * nw for list,
+    // plus WORD_SIZE + 4 for best plus <"{ suggest": > plus <"list": [] }>
+    // that is (WORD_SIZE + 4 ) * ( nw + 1 ) + 32 (with some extra margin),
+    // plus SUGGESTION_SIZE for each suggestion and <"suggestions": [], >
+    size_t size = (WORD_SIZE + 4 ) * ( nw + 1 ) + 32 +
+                  SUGGESTION_SIZE * n_best + 24;
+    buffer = arena_alloc( a, size );
+    sprintf( buffer, "{ \"suggest\": \"%s\", \"suggestions\": [ ",
+             ( 0 == n_best ) ? "" : best[0].word );
+    unsigned int offset = strlen( buffer );
+    for ( int i = 0; i < n_best; ++i ) {
+        offset += snprintf( &buffer[offset], SUGGESTION_SIZE,
+                    "%s{ \"word\": \"%s\", \"entropy\": %.3f, "
+                    "\"expected\": %.3f, \"worst\": %d }",
+                    ( 0 == i ) ? "" : ", ", best[i].word,
+                    best[i].entropy, best[i].expected, best[i].worst );
+    }
+    strcpy( &buffer[offset], " ], \"list\": [ " );
+    offset += strlen( &buffer[offset] );
+    //printf( "Found solution(s)\n" );
+    for ( unsigned int i = 0; i < nw; ++i ) {
+        //printf(" %s\n", words[i] );
+        sprintf( &buffer[offset], "\"%s\"",
+                 get_nth_word_in_dictionary( res->indexes[i] ) );
+        offset += WORD_SIZE + 2; // including ""
+        if ( i != nw-1 ) {
+            strcpy( &buffer[offset], ", " );
+            offset += 2;
+        }
+    }
+    assert( offset < size - 6 );
+    sprintf( &buffer[offset], " ] }" );
+    return buffer;
+}
+
+// the request parameters were parsed at time t (see wmetrics.h)
+static char * solve( solve_parameters *sp, server_worker *sw, uint64_t t )
+{
+    solver_data *sd = &sw->sd;
+    char *data = sp->data;
+    if ( NULL != sp->unknown_strategy ) {
+        add_strategy_error_metric( );
+        return "{ \"error\": \"unknown strategy\" }";
+    }
 //    printf( "data: %s\n", data );
     solver_data_status sds = set_solver_data( sd, data );
+    t = add_phase_metric( SET_DATA_PHASE, t );
 
     if ( SOLVER_DATA_SET != sds ) { // invalid data: return am error
         char *msg;
@@ -208,55 +388,84 @@ static char * solve( char *data, solver_data *sd )
         default:    // to silence gcc
             break;
         }
-        char *buffer = malloc( ERROR_MSG_SIZE );
+        add_error_metric( sds );
+        char *buffer = arena_alloc( sp->a, ERROR_MSG_SIZE );
         snprintf( buffer, ERROR_MSG_SIZE, "{ \"error\": \"%s\" }", msg );
         reset_solver_data( sd );
         return buffer;
     }
-    word_node *res = get_solutions( sd );
-    reset_solver_data( sd );
-
-    char *buffer;
-    if ( NULL == res ) {
-        buffer = malloc( sizeof(EMPTY_RESPONSE) );
-        strcpy( buffer, EMPTY_RESPONSE );
-    } else {
-
-        const char *best = select_most_likely_word( res );
-        if ( NULL == best ) {
-            best = "";
+    // the opening book, if any, has the answers to most requests in the
+    // first two rows: they are copied from the book as is.
+    book_answer ba;
+    if ( 1 == sp->k && ENTROPY_STRATEGY == sp->strategy &&
+         get_book_answer( data, &ba ) ) {
+        if ( 0 != sp->session[0] ) {
+            set_session_solutions( sp->session, data, &ba.candidates );
         }
-        size_t nw = get_word_count( res );
-        const char **words = malloc( sizeof(char *) * nw );
+        reset_solver_data( sd );
+        add_candidates_metric( ba.candidates.n_words );
+        char *buffer = get_solver_response( sp->a, &ba.candidates, &ba.best, ba.n_best );
+        add_phase_metric( SERIALIZATION_PHASE, t );
+        if ( sp->trace ) {
+            log_message( LOG_DEBUG, "book response: %s", buffer );
+        }
+        return buffer;
+    }
 
-        nw = 0;
-        for ( word_node *wn = res ; wn; wn = wn->next ) {
-            words[nw++] = wn->word;
+    // in a session, only the survivors of the previous request are checked,
+    // and the survivors of this request are kept for the next one, even if
+    // the response is cached.
+    arena *a = sp->a;
+    word_span res;
+    bool solved = ( 0 != sp->session[0] );
+    if ( solved ) {
+        if ( ! get_session_solutions( sp->session, data, sd, a, &res ) ) {
+            get_solution_span( sd, a, &res );
         }
-        qsort( words, nw, sizeof(char *), word_cmp );
-
-        // evaluate high boundary for response: (WORD_SIZE + 4) * nw for list,
-        // plus WORD_SIZE + 4 for best plus <"{ suggest": > plus <"list": [] }>
-        // that is (WORD_SIZE + 4 ) * ( nw + 1 ) + 32 (with some extra margin).
-        buffer = malloc( (WORD_SIZE + 4 ) * ( nw + 1 ) + 32 );
-        sprintf( buffer, "{ \"suggest\": \"%s\", \"list\": [ ", best );
-        unsigned int offset = strlen( buffer );
-        //printf( "Found solution(s)\n" );
-        for ( unsigned int i = 0; i < nw; ++i ) {
-            //printf(" %s\n", words[i] );
-            sprintf( &buffer[offset], "\"%s\"", words[i] );
-            offset += WORD_SIZE + 2; // including ""
-            if ( i != nw-1 ) {
-                strcpy( &buffer[offset], ", " );
-                offset += 2;
-            }
+        set_session_solutions( sp->session, data, &res );
+    }
+
+    // equivalent data strings give the same compiled constraint, and the
+    // same response, which is cached as is. The response also depends on the
+    // number of suggestions and on the strategy.
+    solver_constraint sc = sd->constraint;
+    uint32_t options = (uint32_t)sp->k | ( (uint32_t)sp->strategy << 8 );
+    int n_candidates;
+    char *cached = get_cached_response( &sc, options, a, &n_candidates );
+    if ( NULL != cached ) {
+        reset_solver_data( sd );
+        add_candidates_metric( n_candidates );
+        if ( sp->trace ) {
+            log_message( LOG_DEBUG, "cached response: %s", cached );
         }
-        assert( offset < (WORD_SIZE + 4 ) * ( nw + 1 ) + 26 );
-        sprintf( &buffer[offset], " ] }" );
-        free( words );
-        free_word_list( res );
+        return cached;
+    }
+
+    if ( ! solved ) {
+        get_solution_span( sd, a, &res );
+    }
+    reset_solver_data( sd );
+    add_candidates_metric( res.n_words );
+    t = add_phase_metric( SOLUTIONS_PHASE, t );
+
+    suggestion *best = arena_alloc( a, sizeof( suggestion ) * sp->k );
+    int n_best = 0;
+    bool exhausted = false;
+    if ( 0 != res.n_words ) {
+        n_best = get_suggestions( &res, sp->strategy, sp->k, a, best );
+        exhausted = is_suggestion_budget_exhausted( );
+    }
+    t = add_phase_metric( SUGGESTION_PHASE, t );
+    char *buffer = get_solver_response( a, &res, best, n_best );
+    // suggestions cut short by the budget (see -b) are not cached, so that
+    // a later request may get the complete suggestions
+    if ( ! exhausted ) {
+        set_cached_response( &sc, options, buffer, res.n_words );
+    }
+    add_phase_metric( SERIALIZATION_PHASE, t );
+    if ( sp->trace ) {
+        log_message( LOG_DEBUG, "response: %s", buffer );
     }
-    printf( "response:\n%s\n", buffer );
     return buffer;
 }
 
@@ -272,7 +481,7 @@ static char * get_static_page( char *path )
     long len = ftell( f );      // get file size
     rewind( f );
 
-    printf( "file %s length %ld\n", path, len );
+    log_message( LOG_INFO, "file %s length %ld", path, len );
     char *page = malloc( (size_t)len + 1 );
     if ( NULL == page ) {
         printf( "server: could not allocate memory for static page - exiting\n" );
@@ -295,26 +504,88 @@ static char * get_static_page( char *path )
 }
 
 typedef struct {
-    char    *player_path, *solver_path;
-    char    *player_page, *solver_page;
+    char        *player_path, *solver_path;
+    char        *player_page, *solver_page;
+    matrix_type matrix;
+    char        *dictionary;
+    int         session_ttl, session_memory;
+    int         cache_size;
+    int         budget;
+    char        *book;          // opening book, or NULL
+    int         n_threads;      // answering requests
+    server_worker *workers;     // one per thread
+    atomic_int  n_workers;      // taken by threads
+    pthread_mutex_t page_lock;  // static pages are loaded on first use
+    char        *log_path;      // NULL for stdout
+    log_level   log_level;
+    int         log_sampling;   // requests per debug trace
 } wordle_server;
 
 static char *get_player_page( wordle_server *ws )
 {
+    pthread_mutex_lock( &ws->page_lock );
     if ( NULL == ws->player_page ) {
         ws->player_page = get_static_page( ws->player_path );
     }
+    pthread_mutex_unlock( &ws->page_lock );
     return ws->player_page;
 }
 
 static char *get_solver_page( wordle_server *ws )
 {
+    pthread_mutex_lock( &ws->page_lock );
     if ( NULL == ws->solver_page ) {
         ws->solver_page = get_static_page( ws->solver_path );
     }
+    pthread_mutex_unlock( &ws->page_lock );
     return ws->solver_page;
 }
 
+static void init_workers( wordle_server *ws )
+{
+    ws->workers = malloc( sizeof( server_worker ) * ws->n_threads );
+    assert( ws->workers );
+    uint64_t seed = (uint64_t)time( NULL );
+    for ( int i = 0; i < ws->n_threads; ++i ) {
+        server_worker *sw = &ws->workers[i];
+        init_solver_data( &sw->sd );
+        sw->free = NULL;
+        sw->random = ( seed + (uint64_t)i ) * 0x9E3779B97F4A7C15ull | 1;
+    }
+    atomic_init( &ws->n_workers, 0 );
+}
+
+// return the worker owned by the calling thread, or NULL if there are more
+// threads than expected.
+static server_worker *get_worker( wordle_server *ws )
+{
+    if ( NULL == t_worker ) {
+        int i = atomic_fetch_add( &ws->n_workers, 1 );
+        if ( i >= ws->n_threads ) {
+            log_message( LOG_ERROR, "server: no worker left for a new thread" );
+            return NULL;
+        }
+        t_worker = &ws->workers[i];
+    }
+    return t_worker;
+}
+
+static void discard_workers( wordle_server *ws )
+{
+    for ( int i = 0; i < ws->n_threads; ++i ) {
+        server_worker *sw = &ws->workers[i];
+        discard_solver_data( &sw->sd );
+        while ( NULL != sw->free ) {
+            server_request *sr = sw->free;
+            sw->free = sr->next;
+            discard_arena( &sr->a );
+            free( sr );
+        }
+    }
+    free( ws->workers );
+    ws->workers = NULL;
+}
+
 static void free_static_pages( wordle_server *ws )
 {
     if ( NULL != ws->player_page ) {
@@ -327,6 +598,17 @@ static void free_static_pages( wordle_server *ws )
     }
 }
 
+// count a request to endpoint that started at start (see wmetrics.h), and
+// return the time taken to answer it in microseconds
+static long end_request( server_endpoint endpoint, uint64_t start )
+{
+    return (long)( add_request_metric( endpoint, start ) / 1000 );
+}
+
+// each request answered is logged at info level with its parameters, the
+// response size and the time taken to answer it, and with its headers,
+// parameters and response at debug level for sampled requests only. It is
+// also counted in the server metrics, for each phase for solver requests.
 static eMHD_Result answer_to_connection( void *cls,
                                          struct MHD_Connection *connection,
                                          const char *url, const char *method,
@@ -339,11 +621,16 @@ static eMHD_Result answer_to_connection( void *cls,
     (void)version;           /* Unused. Silent compiler warning. */
     (void)upload_data;       /* Unused. Silent compiler warning. */
     (void)upload_data_size;  /* Unused. Silent compiler warning. */
-    (void)con_cls;           /* Unused. Silent compiler warning. */
 
     wordle_server *wsv = cls;
-    MHD_get_connection_values( connection, MHD_HEADER_KIND, &check_headers, NULL );
+    uint64_t start = get_metrics_time( );
+    bool trace = sample_log( );
+    if ( trace ) {
+        MHD_get_connection_values( connection, MHD_HEADER_KIND, &check_headers, NULL );
+    }
     if ( 0 != strcmp( "GET", method ) ) {
+        log_message( LOG_WARNING, "%s %s refused", method, url );
+        end_request( UNKNOWN_ENDPOINT, start );
         return MHD_NO;
     }
 
@@ -354,6 +641,8 @@ static eMHD_Result answer_to_connection( void *cls,
                                              MHD_RESPMEM_PERSISTENT);
         int ret = MHD_queue_response (connection, MHD_HTTP_OK, response);
         MHD_destroy_response (response);
+        log_message( LOG_INFO, "GET %s %d %zu bytes %ld us", url, MHD_HTTP_OK,
+                     strlen( page ), end_request( SOLVER_PAGE_ENDPOINT, start ) );
         return ret;
     }
 
@@ -364,61 +653,145 @@ static eMHD_Result answer_to_connection( void *cls,
                                              MHD_RESPMEM_PERSISTENT);
         int ret = MHD_queue_response (connection, MHD_HTTP_OK, response);
         MHD_destroy_response (response);
+        log_message( LOG_INFO, "GET %s %d %zu bytes %ld us", url, MHD_HTTP_OK,
+                     strlen( page ), end_request( PLAYER_PAGE_ENDPOINT, start ) );
+        return ret;
+    }
+
+    server_worker *sw = get_worker( wsv );
+    if ( NULL == sw ) {
+        return MHD_NO;
+    }
+    server_request *sr = *con_cls;
+    if ( NULL == sr ) {             // released in on_request_completed
+        sr = get_request( sw );
+        *con_cls = sr;
+    }
+
+    if ( 0 == strcmp( url, METRICS_URL ) ) {
+        char *page = get_metrics_text( &sr->a );
+        struct MHD_Response *response =
+            MHD_create_response_from_buffer( strlen( page ), (void *)page,
+                                             MHD_RESPMEM_PERSISTENT);
+        MHD_add_response_header(response, "Content-Type", METRICS_DATA);
+        int ret = MHD_queue_response (connection, MHD_HTTP_OK, response);
+        MHD_destroy_response (response);
+        log_message( LOG_INFO, "GET %s %d %zu bytes %ld us", url, MHD_HTTP_OK,
+                     strlen( page ), end_request( METRICS_ENDPOINT, start ) );
         return ret;
     }
 
     if ( 0 == strncmp( url, PLAYER_API_URL, sizeof(PLAYER_API_URL) - 1 ) ) {
         play_parameters pp;
         pp.game = -1;
+        pp.attempt = 0;
         strcpy( pp.word, "     " );
+        pp.trace = trace;
         MHD_get_connection_values( connection, MHD_GET_ARGUMENT_KIND,
                                    &get_player_query, &pp );
         if ( pp.word != NULL ) {
-            char *page = play( &pp );
+            char *page = play( &pp, sw, &sr->a );
             struct MHD_Response *response = 
                 MHD_create_response_from_buffer( strlen( page ), (void *)page,
-                                                 MHD_RESPMEM_MUST_COPY);
+                                                 MHD_RESPMEM_PERSISTENT);
             MHD_add_response_header(response, "Content-Type", JSON_DATA);
             int ret = MHD_queue_response (connection, MHD_HTTP_OK, response);
             MHD_destroy_response (response);
-            free(page);
+            log_message( LOG_INFO, "GET %s?game=%d&attempt=%d&word=%s %d %zu bytes %ld us",
+                         url, pp.game, pp.attempt, pp.word, MHD_HTTP_OK,
+                         strlen( page ), end_request( PLAY_ENDPOINT, start ) );
             return ret;
         }
     }
 
     if ( 0 == strncmp( url, SOLVER_API_URL, sizeof(SOLVER_API_URL) - 1 ) ) {
-        char *data = NULL;
+        solve_parameters sp;
+        sp.a = &sr->a;
+        sp.data = NULL;
+        sp.session[0] = 0;
+        sp.k = 1;
+        sp.strategy = ENTROPY_STRATEGY;
+        sp.unknown_strategy = NULL;
+        sp.trace = trace;
         MHD_get_connection_values( connection, MHD_GET_ARGUMENT_KIND,
-                                   &get_solver_query, &data );
-        if ( data != NULL ) {
-            solver_data sd;
-            init_solver_data( &sd );
-            char *page = solve( data, &sd );
+                                   &get_solver_query, &sp );
+        if ( sp.data != NULL ) {
+            char *page = solve( &sp, sw, add_phase_metric( PARSE_PHASE, start ) );
             struct MHD_Response *response = 
                 MHD_create_response_from_buffer( strlen( page ), (void *)page,
-                                                 MHD_RESPMEM_MUST_COPY);
+                                                 MHD_RESPMEM_PERSISTENT);
             MHD_add_response_header(response, "Content-Type", JSON_DATA);
             int ret = MHD_queue_response (connection, MHD_HTTP_OK, response);
             MHD_destroy_response (response);
-            free(page);
-            discard_solver_data( &sd );
-            free( data );
+            log_message( LOG_INFO, "GET %s?data=%s&k=%d&strategy=%s%s%s %d %zu bytes %ld us",
+                         url, sp.data, sp.k, ( NULL != sp.unknown_strategy ) ?
+                         sp.unknown_strategy : get_strategy_name( sp.strategy ),
+                         ( 0 == sp.session[0] ) ? "" : "&session=", sp.session,
+                         MHD_HTTP_OK, strlen( page ), end_request( SOLVE_ENDPOINT, start ) );
             return ret;
         }
     }
+    log_message( LOG_WARNING, "GET %s not found", url );
+    end_request( UNKNOWN_ENDPOINT, start );
     return MHD_NO;
 }
 
+// the response was sent: the request arena can be reused
+static void on_request_completed( void *cls, struct MHD_Connection *connection,
+                                  void **con_cls,
+                                  enum MHD_RequestTerminationCode toe )
+{
+    (void)cls;
+    (void)connection;
+    (void)toe;
+    if ( NULL != *con_cls ) {
+        release_request( *con_cls );
+        *con_cls = NULL;
+    }
+}
+
+static void on_connection( void *cls, struct MHD_Connection *connection,
+                           void **socket_context,
+                           enum MHD_ConnectionNotificationCode toe )
+{
+    (void)cls;
+    (void)connection;
+    (void)socket_context;
+    add_connection_metric( MHD_CONNECTION_NOTIFY_STARTED == toe );
+}
+
 static void help( void )
 {
     printf( "Wordle server\n\n" );
     printf( "Simple server for a wordle game player and solver. The player\n" );
     printf( "and solver are accessible at two different urls, respectively\n" );
-    printf( "/wordle/player and /wordle/solver.\n\n");
-    printf( "Usage:\n  wserver [-h] [-p=<path>] [-s=<path>]\n\n" );
+    printf( "/wordle/player and /wordle/solver. Server metrics are available in\n" );
+    printf( "the Prometheus text format at /wordle/metrics.\n\n");
+    printf( "Usage:\n  wserver [-h] [-p=<path>] [-s=<path>] [-m=<matrix>] [-w=<path>]\n" );
+    printf( "          [-e=<ttl>[,<size>]] [-c=<entries>] [-b=<ms>] [-o=<path>] [-t=<n>]\n" );
+    printf( "          [-l=<path>[,<level>[,<n>]]]\n\n" );
     printf( "Options:\n     -h          print this help and exit\n" );
     printf( "     -p=<path>   path to the player main html page (default player.html)\n" );
     printf( "     -s=<path>   path to the solver main html page (default solver.html)\n" );
+    printf( "     -m=<matrix> feedback matrix: auto (default), full, tiled or none\n" );
+    printf( "     -w=<path>   path to the dictionary, text or compiled (default dict.txt)\n" );
+    printf( "     -e=<ttl>[,<size>] solver sessions expire after ttl seconds without\n" );
+    printf( "                 use (default %d), and take at most size MB (default %d)\n",
+            SESSION_TTL, MAX_SESSION_MEMORY );
+    printf( "     -c=<entries> number of solver responses kept in cache (default %d),\n", SOLVER_CACHE_SIZE );
+    printf( "                 0 to disable the cache\n" );
+    printf( "     -b=<ms>     time budget to select a suggestion (default %d), 0 for none\n", SUGGESTION_BUDGET );
+    printf( "     -o=<path>   opening book built by wordle --build-book (default none)\n" );
+    printf( "     -t=<n>      number of threads answering requests (default 1)\n" );
+    printf( "     -l=<path>[,<level>[,<n>]] log file, - for the standard output (default),\n" );
+    printf( "                 log level: error, warning, info (default) or debug, and\n" );
+    printf( "                 requests traced at debug level: 1 in n (default 1)\n" );
+    printf( "\nThe solver keeps the words that matched the last request in a session\n" );
+    printf( "when a session id is given, as in /wordle/solver/solve?data=...&session=<id>.\n" );
+    printf( "A later request in the same session with more data checks only those words.\n" );
+    printf( "The solver returns the k best words to try with their scores if k=<k> is\n" );
+    printf( "given (1 by default, at most %d), compared according to strategy=<name>:\n", MAX_SUGGESTIONS );
+    printf( "entropy (the default), minimax, expected or positional.\n" );
 }
 
 static void error( char *message )
@@ -435,6 +808,19 @@ static void get_args( int argc, char **argv, wordle_server *wsv )
     wsv->solver_path = DEFAULT_SOLVER_PATH;
     wsv->player_page = NULL;
     wsv->solver_page = NULL;
+    wsv->matrix = AUTO_MATRIX;
+    wsv->dictionary = WORDLE_DICTIONARY;
+    wsv->session_ttl = SESSION_TTL;
+    wsv->session_memory = MAX_SESSION_MEMORY;
+    wsv->cache_size = SOLVER_CACHE_SIZE;
+    wsv->budget = SUGGESTION_BUDGET;
+    wsv->book = NULL;
+    wsv->n_threads = 1;
+    wsv->workers = NULL;
+    wsv->log_path = NULL;
+    wsv->log_level = LOG_INFO;
+    wsv->log_sampling = 1;
+    pthread_mutex_init( &wsv->page_lock, NULL );
 
     char **pp = &argv[1];
     while (--argc) {
@@ -456,8 +842,86 @@ static void get_args( int argc, char **argv, wordle_server *wsv )
                 }
                 wsv->solver_path = s;
                 break;
+            case 'm': case 'M':
+                if (*s++ != '=') {
+                    error( "missing '=' after option m" );
+                }
+                if ( ! get_matrix_type_from_name( s, &wsv->matrix ) ) {
+                    error( "invalid matrix type after option m" );
+                }
+                break;
+            case 'w': case 'W':
+                if (*s++ != '=') {
+                    error( "missing '=' after option w" );
+                }
+                wsv->dictionary = s;
+                break;
+            case 'e': case 'E':
+                if (*s++ != '=') {
+                    error( "missing '=' after option e" );
+                }
+                if ( sscanf( s, "%d,%d", &wsv->session_ttl, &wsv->session_memory ) < 1 ||
+                     wsv->session_ttl < 0 || wsv->session_memory < 0 ) {
+                    error( "invalid session ttl or size after option e" );
+                }
+                break;
+            case 'c': case 'C':
+                if (*s++ != '=') {
+                    error( "missing '=' after option c" );
+                }
+                wsv->cache_size = get_int_value( s );
+                if ( wsv->cache_size < 0 ) {
+                    error( "invalid number of entries after option c" );
+                }
+                break;
+            case 'b': case 'B':
+                if (*s++ != '=') {
+                    error( "missing '=' after option b" );
+                }
+                wsv->budget = get_int_value( s );
+                if ( wsv->budget < 0 ) {
+                    error( "invalid time budget after option b" );
+                }
+                break;
+            case 'o': case 'O':
+                if (*s++ != '=') {
+                    error( "missing '=' after option o" );
+                }
+                wsv->book = s;
+                break;
+            case 't': case 'T':
+                if (*s++ != '=') {
+                    error( "missing '=' after option t" );
+                }
+                wsv->n_threads = get_int_value( s );
+                if ( wsv->n_threads < 1 ) {
+                    error( "invalid number of threads after option t" );
+                }
+                break;
+            case 'l': case 'L':
+                if (*s++ != '=') {
+                    error( "missing '=' after option l" );
+                }
+                wsv->log_path = s;
+                s = strchr( s, ',' );
+                if ( NULL != s ) {
+                    *s++ = 0;
+                    char *n = strchr( s, ',' );
+                    if ( NULL != n ) {
+                        *n++ = 0;
+                        wsv->log_sampling = get_int_value( n );
+                        if ( wsv->log_sampling < 1 ) {
+                            error( "invalid sampling after option l" );
+                        }
+                    }
+                    if ( ! get_log_level_from_name( s, &wsv->log_level ) ) {
+                        error( "invalid log level after option l" );
+                    }
+                }
+                break;
             }
         }
+        pp++;
     }
 }
 
@@ -468,16 +932,48 @@ extern int main( int argc, char **argv )
     wordle_server wsv;
     get_args( argc, argv, &wsv );
 
-    unsigned int seed = time( NULL );
-    srand( seed );
+    load_dictionary( wsv.dictionary );
+    thread_pool *pool = create_thread_pool( 0 );
+    init_feedback_matrix( wsv.matrix, pool );
+    init_sessions( wsv.session_ttl, (size_t)wsv.session_memory * 1024 * 1024 );
+    init_solver_cache( wsv.cache_size );
+    init_suggestions( pool, wsv.budget );
+    if ( NULL != wsv.book ) {
+        load_opening_book( wsv.book );
+    }
+
+    init_workers( &wsv );
 
-    load_dictionary( WORDLE_DICTIONARY );
-    printf( "Starting wordle server\n" );
+    init_log( wsv.log_path, wsv.log_level, wsv.log_sampling );
+    printf( "Starting wordle server with %d thread(s)\n", wsv.n_threads );
     struct MHD_Daemon *daemon;
-    daemon = MHD_start_daemon( MHD_USE_AUTO | MHD_USE_INTERNAL_POLLING_THREAD, PORT,
-                               &on_client_connect, NULL,
-                               &answer_to_connection, &wsv, MHD_OPTION_END );
+    if ( 1 == wsv.n_threads ) {
+        daemon = MHD_start_daemon( MHD_USE_AUTO | MHD_USE_INTERNAL_POLLING_THREAD, PORT,
+                                   &on_client_connect, NULL,
+                                   &answer_to_connection, &wsv,
+                                   MHD_OPTION_NOTIFY_COMPLETED,
+                                   &on_request_completed, NULL,
+                                   MHD_OPTION_NOTIFY_CONNECTION,
+                                   &on_connection, NULL, MHD_OPTION_END );
+    } else {
+        daemon = MHD_start_daemon( MHD_USE_AUTO | MHD_USE_INTERNAL_POLLING_THREAD, PORT,
+                                   &on_client_connect, NULL,
+                                   &answer_to_connection, &wsv,
+                                   MHD_OPTION_NOTIFY_COMPLETED,
+                                   &on_request_completed, NULL,
+                                   MHD_OPTION_NOTIFY_CONNECTION,
+                                   &on_connection, NULL,
+                                   MHD_OPTION_THREAD_POOL_SIZE,
+                                   (unsigned int)wsv.n_threads, MHD_OPTION_END );
+    }
     if (NULL == daemon) {
+        discard_log( );
+        discard_workers( &wsv );
+        discard_opening_book( );
+        discard_solver_cache( );
+        discard_sessions( );
+        discard_feedback_matrix( );
+        discard_thread_pool( pool );
         discard_dictionary( );
         return 1;
     }
@@ -488,8 +984,26 @@ extern int main( int argc, char **argv )
     pause( );
 #endif
     MHD_stop_daemon (daemon);
+    discard_log( );
+    log_stats ls;
+    get_log_stats( &ls );
+    printf( "Log: %llu messages written, %llu dropped\n",
+            (unsigned long long)ls.written, (unsigned long long)ls.dropped );
+    solver_cache_stats stats;
+    get_solver_cache_stats( &stats );
+    printf( "Solver cache: %llu hits, %llu misses, %llu insertions, %llu evictions\n",
+            (unsigned long long)stats.hits, (unsigned long long)stats.misses,
+            (unsigned long long)stats.insertions, (unsigned long long)stats.evictions );
+    discard_opening_book( );
+    discard_solver_cache( );
+    discard_sessions( );
+    discard_feedback_matrix( );
+    discard_workers( &wsv );
+    discard_metrics( );
+    discard_thread_pool( pool );
     discard_dictionary( );
     free_static_pages(  &wsv );
+    pthread_mutex_destroy( &wsv.page_lock );
     printf( "Exiting wordle server\n" );
     return 0;
 }
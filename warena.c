@@ -0,0 +1,97 @@
+
+#include <stdio.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <stddef.h>
+#include <assert.h>
+
+#include "warena.h"
+
+#define ARENA_ALIGNMENT     _Alignof(max_align_t)
+#define ALIGN(s)            ( ((s) + ARENA_ALIGNMENT - 1) & ~(ARENA_ALIGNMENT - 1) )
+
+struct _arena_block {
+    arena_block     *next;
+    max_align_t     data[];     // block data follows, aligned for any type
+};
+
+extern void init_arena( arena *a, size_t size )
+{
+    init_arena_from_buffer( a, malloc( size ), size );
+    assert( a->buffer );
+    a->owned = true;
+}
+
+extern void init_arena_from_buffer( arena *a, void *buffer, size_t size )
+{
+    // make sure the first allocation is aligned, even in a caller's buffer
+    size_t skip = ( ARENA_ALIGNMENT - ( (uintptr_t)buffer % ARENA_ALIGNMENT ) )
+                                                            % ARENA_ALIGNMENT;
+    if ( skip > size ) {
+        skip = size;
+    }
+    a->buffer = (char *)buffer + skip;
+    a->size = size - skip;
+    a->current = a->buffer;
+    a->current_size = a->size;
+    a->used = 0;
+    a->extra = NULL;
+    a->owned = false;
+}
+
+extern void *arena_alloc( arena *a, size_t size )
+{
+    size = ALIGN( size );
+    if ( a->used + size > a->current_size ) {   // allocate an extra block
+        size_t block_size = 2 * a->current_size;
+        if ( block_size < size ) {
+            block_size = size;
+        }
+        arena_block *ab = malloc( sizeof( arena_block ) + block_size );
+        assert( ab );
+        ab->next = a->extra;
+        a->extra = ab;
+        a->current = (char *)ab->data;
+        a->current_size = block_size;
+        a->used = 0;
+    }
+    void *p = &a->current[ a->used ];
+    a->used += size;
+    return p;
+}
+
+extern void *arena_alloc_aligned( arena *a, size_t size, size_t alignment )
+{
+    assert( 0 == ( alignment & ( alignment - 1 ) ) );
+    if ( alignment <= ARENA_ALIGNMENT ) {
+        return arena_alloc( a, size );
+    }
+    // blocks are only aligned for any type: the padding is allocated too
+    uintptr_t p = (uintptr_t)arena_alloc( a, size + alignment - ARENA_ALIGNMENT );
+    return (void *)( ( p + alignment - 1 ) & ~(uintptr_t)( alignment - 1 ) );
+}
+
+extern void reset_arena( arena *a )
+{
+    arena_block *next;
+    for ( arena_block *ab = a->extra; ab; ab = next ) {
+        next = ab->next;
+        free( ab );
+    }
+    a->extra = NULL;
+    a->current = a->buffer;
+    a->current_size = a->size;
+    a->used = 0;
+}
+
+extern void discard_arena( arena *a )
+{
+    reset_arena( a );
+    if ( a->owned ) {
+        // the buffer may have been moved forward for alignment, but malloc
+        // always returns aligned memory so that buffer is the original block
+        free( a->buffer );
+    }
+    a->buffer = a->current = NULL;
+    a->size = a->current_size = 0;
+}
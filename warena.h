@@ -0,0 +1,47 @@
+
+#ifndef __WARENA_H__
+#define __WARENA_H__
+
+#include <stddef.h>
+#include <stdbool.h>
+
+// An arena is a bump allocator: memory is allocated by simply moving forward
+// in a block, and it is never freed individually. All allocations are freed
+// at once when the arena is reset. If the first block is exhausted, extra
+// blocks are allocated on the heap and freed when the arena is reset, so that
+// an allocation in an arena never fails.
+
+typedef struct _arena_block arena_block;
+
+typedef struct {
+    char        *buffer;        // first block
+    size_t      size;           // size of first block
+    char        *current;       // current block (first block or last extra)
+    size_t      current_size;
+    size_t      used;           // in current block
+    arena_block *extra;         // extra blocks, most recent first
+    bool        owned;          // first block allocated by init_arena
+} arena;
+
+// initialize an arena with a first block of size bytes allocated on the heap
+extern void init_arena( arena *a, size_t size );
+
+// initialize an arena using a buffer of size bytes given by the caller. The
+// buffer must stay valid as long as the arena is used, and it is not freed by
+// discard_arena.
+extern void init_arena_from_buffer( arena *a, void *buffer, size_t size );
+
+// return size bytes allocated in the arena, aligned for any type.
+extern void *arena_alloc( arena *a, size_t size );
+
+// return size bytes allocated in the arena, aligned on alignment bytes, which
+// must be a power of 2 (e.g. for SIMD loads).
+extern void *arena_alloc_aligned( arena *a, size_t size, size_t alignment );
+
+// free all allocations at once. The first block is kept for reuse.
+extern void reset_arena( arena *a );
+
+// free all allocations and the first block if it was allocated by init_arena
+extern void discard_arena( arena *a );
+
+#endif /* __WARENA_H__ */
@@ -0,0 +1,610 @@
+
+#include <stdio.h>
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+#include <strings.h>
+#include <stdatomic.h>
+#include <time.h>
+#include <assert.h>
+
+#include <unistd.h>
+#include <pthread.h>
+
+#include <sys/types.h>
+#include <sys/socket.h>
+#include <netinet/in.h>
+#include <netinet/tcp.h>
+#include <arpa/inet.h>
+
+#include "wordle.h"
+#include "wdict.h"
+#include "wsolve.h"
+#include "wmatrix.h"
+#include "wpool.h"
+#include "wsuggest.h"
+#include "wsim.h"
+
+/*
+    The benchmark sends requests to a server running on localhost, through
+    n connections kept alive, each in its own thread. Requests are either
+    generated by playing games as a player following the solver would (see
+    wsim.h): for each word tried, a player request, and if the word is not
+    the answer, a solver request with all rows so far; or they are read from
+    the access records in a server log, and sent with the same pacing as in
+    the log.
+
+    Each thread takes the next request to send from a shared counter and
+    waits for the response before taking another one. The latency of a
+    request is measured from the time it was sent, or from the time it should
+    have been sent when replaying a log, so that requests delayed because
+    all connections were busy count as slow requests. Requests that failed
+    without a response (connection refused or closed) are only counted: they
+    are not included in the latencies and the throughput.
+*/
+
+#define DEFAULT_PORT        8888
+#define DEFAULT_CONNECTIONS 8
+#define DEFAULT_GAMES       500
+
+#define PLAYER_API_URL      "/wordle/player/play"
+#define SOLVER_API_URL      "/wordle/solver/solve"
+
+#define MAX_PATH_SIZE       192
+#define BUFFER_SIZE         (64 * 1024)
+
+typedef enum {
+    PLAY_REQUEST, SOLVE_REQUEST, N_REQUEST_KINDS
+} request_kind;
+
+static const char *s_kind_names[N_REQUEST_KINDS] = { "play", "solve" };
+
+typedef struct {
+    char            path[MAX_PATH_SIZE];
+    request_kind    kind;
+    uint64_t        at;             // ns after the first request, in a log
+} bench_request;
+
+typedef struct {
+    bench_request   *requests;
+    int             n_requests, capacity;
+} request_list;
+
+typedef struct {
+    int         n_connections;
+    int         n_requests;         // 0 for all requests in the list
+    int         n_games;
+    suggest_strategy strategy;
+    char        *log;               // or NULL to generate requests
+    int         port;
+    char        *dictionary;
+    matrix_type matrix;
+} bench_args;
+
+typedef struct {
+    const request_list  *list;
+    int                 n_requests;
+    bool                paced;      // requests sent at their time in the log
+    uint64_t            start;
+    struct sockaddr_in  address;
+    atomic_int          next;       // next request to send
+    uint64_t            *latencies; // ns, for each request sent
+    int                 *status;    // of each response, 0 if none
+} bench;
+
+static uint64_t get_time( void )
+{
+    struct timespec now;
+    clock_gettime( CLOCK_MONOTONIC, &now );
+    return (uint64_t)now.tv_sec * 1000000000ull + (uint64_t)now.tv_nsec;
+}
+
+static bench_request *add_request( request_list *rl, request_kind kind )
+{
+    if ( rl->n_requests == rl->capacity ) {
+        rl->capacity = ( 0 == rl->capacity ) ? 1024 : 2 * rl->capacity;
+        rl->requests = realloc( rl->requests,
+                                sizeof( bench_request ) * rl->capacity );
+        if ( NULL == rl->requests ) {
+            printf( "wbench: could not allocate memory for requests - exiting\n" );
+            exit(1);
+        }
+    }
+    bench_request *br = &rl->requests[rl->n_requests++];
+    br->kind = kind;
+    br->at = 0;
+    return br;
+}
+
+// play n_games games for random words in the dictionary, always the same
+// ones for the same dictionary, and add their requests to the list.
+static void generate_requests( request_list *rl, int n_games,
+                               suggest_strategy strategy )
+{
+    int n_words = get_dictionary_size();
+    arena a;
+    init_arena( &a, sizeof(int) * 4 * ( n_words + 64 ) );
+
+    word_span all;
+    all.n_words = n_words;
+    all.indexes = arena_alloc( &a, sizeof(int) * n_words );
+    for ( int i = 0; i < n_words; ++i ) {
+        all.indexes[i] = i;
+    }
+    suggestion best;
+    const char *first = ( 0 != get_suggestions( &all, strategy, 1, &a, &best ) ) ?
+                        best.word : get_nth_word_in_dictionary( 0 );
+
+    solver_data given;
+    init_solver_data( &given );
+    uint64_t random = 0x9E3779B97F4A7C15ull;
+    for ( int g = 0; g < n_games; ++g ) {
+        random ^= random << 13;         // xorshift64
+        random ^= random >> 7;
+        random ^= random << 17;
+        int game = (int)( random % (uint64_t)n_words );
+
+        char data[ MAX_TRIES * 2 * WORD_SIZE + 1 ];
+        int tries = play_game( strategy, first, get_nth_word_in_dictionary( game ),
+                               &given, &a, data );
+        int n_rows = ( 0 == tries ) ? MAX_TRIES : tries;
+        for ( int r = 0; r < n_rows; ++r ) {
+            char word[WORD_SIZE+1];
+            for ( int k = 0; k < WORD_SIZE; ++k ) {
+                word[k] = data[ 2 * ( r * WORD_SIZE + k ) + 1 ];
+            }
+            word[WORD_SIZE] = 0;
+            bench_request *br = add_request( rl, PLAY_REQUEST );
+            snprintf( br->path, MAX_PATH_SIZE, "%s?game=%d&attempt=%d&word=%s",
+                      PLAYER_API_URL, game, r, word );
+            if ( r < n_rows - 1 ) {     // not the answer
+                br = add_request( rl, SOLVE_REQUEST );
+                snprintf( br->path, MAX_PATH_SIZE, "%s?data=%.*s", SOLVER_API_URL,
+                          ( r + 1 ) * 2 * WORD_SIZE, data );
+            }
+        }
+    }
+    discard_solver_data( &given );
+    discard_arena( &a );
+}
+
+static int compare_request_times( const void *r1, const void *r2 )
+{
+    uint64_t at1 = ((const bench_request *)r1)->at;
+    uint64_t at2 = ((const bench_request *)r2)->at;
+    return ( at1 > at2 ) - ( at1 < at2 );
+}
+
+// add the requests found in the access records of a server log (see server
+// option -l), in time order. Records in the log are not in time order when
+// the server has several threads.
+static void load_requests( request_list *rl, const char *path )
+{
+    FILE *f = fopen( path, "r" );
+    if ( NULL == f ) {
+        printf( "wbench: could not open log %s - exiting\n", path );
+        exit(1);
+    }
+    char line[1024];
+    while ( NULL != fgets( line, sizeof(line), f ) ) {
+        struct tm tm;
+        memset( &tm, 0, sizeof(tm) );
+        int micro;
+        if ( 7 != sscanf( line, "%d-%d-%d %d:%d:%d.%d", &tm.tm_year, &tm.tm_mon,
+                          &tm.tm_mday, &tm.tm_hour, &tm.tm_min, &tm.tm_sec,
+                          &micro ) ) {
+            continue;
+        }
+        char *url = strstr( line, " info " );
+        if ( NULL == url || NULL == ( url = strstr( url, " GET " ) ) ) {
+            continue;
+        }
+        url += 5;
+        char *end = strchr( url, ' ' );
+        if ( NULL == end || end - url >= MAX_PATH_SIZE ) {
+            continue;
+        }
+        request_kind kind;
+        if ( 0 == strncmp( url, PLAYER_API_URL, sizeof(PLAYER_API_URL) - 1 ) ) {
+            kind = PLAY_REQUEST;
+        } else if ( 0 == strncmp( url, SOLVER_API_URL, sizeof(SOLVER_API_URL) - 1 ) ) {
+            kind = SOLVE_REQUEST;
+        } else {
+            continue;
+        }
+        tm.tm_year -= 1900;
+        tm.tm_mon -= 1;
+        tm.tm_isdst = -1;
+        bench_request *br = add_request( rl, kind );
+        memcpy( br->path, url, end - url );
+        br->path[end - url] = 0;
+        br->at = (uint64_t)mktime( &tm ) * 1000000000ull + (uint64_t)micro * 1000;
+    }
+    fclose( f );
+    if ( 0 == rl->n_requests ) {
+        printf( "wbench: no request found in log %s - exiting\n", path );
+        exit(1);
+    }
+    qsort( rl->requests, rl->n_requests, sizeof( bench_request ),
+           compare_request_times );
+    uint64_t first = rl->requests[0].at;
+    for ( int i = 0; i < rl->n_requests; ++i ) {
+        rl->requests[i].at -= first;
+    }
+}
+
+static int open_connection( const bench *b )
+{
+    int fd = socket( AF_INET, SOCK_STREAM, 0 );
+    if ( -1 == fd ) {
+        return -1;
+    }
+    int one = 1;
+    setsockopt( fd, IPPROTO_TCP, TCP_NODELAY, &one, sizeof(one) );
+    if ( 0 != connect( fd, (const struct sockaddr *)&b->address,
+                       sizeof( b->address ) ) ) {
+        close( fd );
+        return -1;
+    }
+    return fd;
+}
+
+// send a request on the connection and read its response in buffer. Return
+// the response status, or 0 if the connection failed, and set keep to false
+// if the server closes the connection after the response.
+static int send_request( int fd, const char *path, char *buffer, bool *keep )
+{
+    int size = snprintf( buffer, BUFFER_SIZE,
+                         "GET %s HTTP/1.1\r\nHost: localhost\r\n\r\n", path );
+    for ( int sent = 0; sent < size; ) {
+        ssize_t n = write( fd, &buffer[sent], size - sent );
+        if ( n <= 0 ) {
+            return 0;
+        }
+        sent += (int)n;
+    }
+
+    size_t used = 0;
+    char *body = NULL;
+    while ( NULL == body ) {
+        if ( BUFFER_SIZE - 1 == used ) {
+            return 0;
+        }
+        ssize_t n = read( fd, &buffer[used], BUFFER_SIZE - 1 - used );
+        if ( n <= 0 ) {
+            return 0;
+        }
+        used += (size_t)n;
+        buffer[used] = 0;
+        body = strstr( buffer, "\r\n\r\n" );
+    }
+    *body = 0;
+    body += 4;
+
+    int status = 0;
+    if ( 1 != sscanf( buffer, "HTTP/%*s %d", &status ) ) {
+        return 0;
+    }
+    size_t length = 0;
+    *keep = true;
+    for ( char *line = strstr( buffer, "\r\n" ); NULL != line;
+          line = strstr( line, "\r\n" ) ) {
+        line += 2;
+        if ( 0 == strncasecmp( line, "Content-Length:", 15 ) ) {
+            length = (size_t)strtoul( &line[15], NULL, 10 );
+        } else if ( 0 == strncasecmp( line, "Connection: close", 17 ) ) {
+            *keep = false;
+        }
+    }
+
+    size_t received = used - (size_t)( body - buffer );
+    while ( received < length ) {
+        size_t left = length - received;
+        ssize_t n = read( fd, buffer, ( left < BUFFER_SIZE ) ? left : BUFFER_SIZE );
+        if ( n <= 0 ) {
+            return 0;
+        }
+        received += (size_t)n;
+    }
+    return status;
+}
+
+static void *run_connection( void *arg )
+{
+    bench *b = arg;
+    char *buffer = malloc( BUFFER_SIZE );
+    assert( buffer );
+    int fd = -1;
+    while ( true ) {
+        int i = atomic_fetch_add( &b->next, 1 );
+        if ( i >= b->n_requests ) {
+            break;
+        }
+        const bench_request *br = &b->list->requests[ i % b->list->n_requests ];
+        uint64_t sent;
+        if ( b->paced ) {
+            sent = b->start + br->at;
+            struct timespec ts;
+            ts.tv_sec = (time_t)( sent / 1000000000ull );
+            ts.tv_nsec = (long)( sent % 1000000000ull );
+            while ( 0 != clock_nanosleep( CLOCK_MONOTONIC, TIMER_ABSTIME, &ts, NULL ) ) {
+            }
+        } else {
+            sent = get_time( );
+        }
+
+        if ( -1 == fd ) {
+            fd = open_connection( b );
+        }
+        bool keep = false;
+        b->status[i] = ( -1 == fd ) ? 0 : send_request( fd, br->path, buffer, &keep );
+        b->latencies[i] = get_time( ) - sent;
+        if ( ! keep && -1 != fd ) {
+            close( fd );
+            fd = -1;
+        }
+    }
+    if ( -1 != fd ) {
+        close( fd );
+    }
+    free( buffer );
+    return NULL;
+}
+
+static int compare_latencies( const void *l1, const void *l2 )
+{
+    uint64_t v1 = *(const uint64_t *)l1, v2 = *(const uint64_t *)l2;
+    return ( v1 > v2 ) - ( v1 < v2 );
+}
+
+// latency at percentile p in sorted latencies, in ms
+static double get_percentile( const uint64_t *latencies, int n, double p )
+{
+    int i = (int)( p * n + 0.999999 ) - 1;
+    if ( i < 0 ) {
+        i = 0;
+    }
+    return (double)latencies[i] / 1e6;
+}
+
+// print the latencies of the requests of the given kind, or of all requests
+// if kind is N_REQUEST_KINDS, and return the number of failed requests.
+static int print_latencies( const bench *b, request_kind kind, double elapsed )
+{
+    uint64_t *latencies = malloc( sizeof( uint64_t ) * b->n_requests );
+    assert( latencies );
+    int n_requests = 0, n_failed = 0, n_errors = 0, n = 0;
+    double sum = 0.0;
+    for ( int i = 0; i < b->n_requests; ++i ) {
+        const bench_request *br = &b->list->requests[ i % b->list->n_requests ];
+        if ( N_REQUEST_KINDS != kind && kind != br->kind ) {
+            continue;
+        }
+        ++n_requests;
+        if ( 0 == b->status[i] ) {      // no response
+            ++n_failed;
+            continue;
+        }
+        if ( 200 != b->status[i] ) {
+            ++n_errors;
+        }
+        latencies[n++] = b->latencies[i];
+        sum += (double)b->latencies[i];
+    }
+    const char *name = ( N_REQUEST_KINDS == kind ) ? "all" : s_kind_names[kind];
+    if ( 0 != n ) {
+        qsort( latencies, n, sizeof( uint64_t ), compare_latencies );
+        printf( "  %-5s %8d %6d %6d %10.1f %8.3f %8.3f %8.3f %8.3f %8.3f\n",
+                name, n_requests, n_failed, n_errors, (double)n / elapsed,
+                sum / n / 1e6,
+                get_percentile( latencies, n, 0.5 ),
+                get_percentile( latencies, n, 0.99 ),
+                get_percentile( latencies, n, 0.999 ),
+                (double)latencies[n-1] / 1e6 );
+    } else if ( 0 != n_requests ) {
+        printf( "  %-5s %8d %6d %6d          -        -        -        -        -        -\n",
+                name, n_requests, n_failed, n_errors );
+    }
+    free( latencies );
+    return n_failed;
+}
+
+static void run_bench( const bench_args *args, const request_list *rl )
+{
+    bench b;
+    b.list = rl;
+    b.paced = ( NULL != args->log );
+    b.n_requests = ( 0 == args->n_requests ||
+                     ( b.paced && args->n_requests > rl->n_requests ) ) ?
+                   rl->n_requests : args->n_requests;
+    memset( &b.address, 0, sizeof( b.address ) );
+    b.address.sin_family = AF_INET;
+    b.address.sin_port = htons( (uint16_t)args->port );
+    b.address.sin_addr.s_addr = htonl( INADDR_LOOPBACK );
+    atomic_init( &b.next, 0 );
+    b.latencies = malloc( sizeof( uint64_t ) * b.n_requests );
+    b.status = malloc( sizeof( int ) * b.n_requests );
+    pthread_t *threads = malloc( sizeof( pthread_t ) * args->n_connections );
+    assert( b.latencies && b.status && threads );
+
+    // a server that is not running would fail all requests at once
+    int fd = open_connection( &b );
+    if ( -1 == fd ) {
+        printf( "wbench: could not connect to localhost:%d - exiting\n", args->port );
+        exit(1);
+    }
+    close( fd );
+
+    printf( "Sending %d requests to localhost:%d through %d connection(s)%s\n",
+            b.n_requests, args->port, args->n_connections,
+            b.paced ? " with the pacing of the log" : "" );
+    b.start = get_time( );
+    for ( int i = 0; i < args->n_connections; ++i ) {
+        if ( 0 != pthread_create( &threads[i], NULL, run_connection, &b ) ) {
+            printf( "wbench: could not start a connection thread - exiting\n" );
+            exit(1);
+        }
+    }
+    for ( int i = 0; i < args->n_connections; ++i ) {
+        pthread_join( threads[i], NULL );
+    }
+    double elapsed = (double)( get_time( ) - b.start ) / 1e9;
+
+    printf( "Time: %.3f s\n", elapsed );
+    printf( "  kind  requests failed errors  request/s  latency ms: mean      p50      p99    p99.9      max\n" );
+    for ( int k = 0; k < N_REQUEST_KINDS; ++k ) {
+        print_latencies( &b, (request_kind)k, elapsed );
+    }
+    int n_failed = print_latencies( &b, N_REQUEST_KINDS, elapsed );
+    if ( 0 != n_failed ) {
+        printf( "wbench: warning %d request(s) failed without a response, not included\n"
+                "        in the request/s and latencies\n", n_failed );
+    }
+    free( threads );
+    free( b.status );
+    free( b.latencies );
+}
+
+static void help( void )
+{
+    printf( "Wordle server benchmark\n\n" );
+    printf( "Sends solver and player requests to a wordle server running on localhost\n" );
+    printf( "and prints the throughput and latency percentiles of its responses.\n\n" );
+    printf( "Usage:\n  wbench [-h] [-c=<n>] [-n=<n>] [-g=<n>] [-s=<strategy>] [-l=<path>]\n" );
+    printf( "         [-p=<port>] [-w=<path>] [-m=<matrix>]\n\n" );
+    printf( "Options:\n     -h          print this help and exit\n" );
+    printf( "     -c=<n>      number of connections kept alive (default %d)\n", DEFAULT_CONNECTIONS );
+    printf( "     -n=<n>      number of requests to send, cycling through the requests\n" );
+    printf( "                 generated (default all of them once)\n" );
+    printf( "     -g=<n>      number of games played to generate requests (default %d)\n", DEFAULT_GAMES );
+    printf( "     -s=<name>   strategy followed in games: entropy (default), minimax,\n" );
+    printf( "                 expected or positional\n" );
+    printf( "     -l=<path>   send the requests found in a server log (see wserver -l)\n" );
+    printf( "                 at the same pace, instead of playing games\n" );
+    printf( "     -p=<port>   server port (default %d)\n", DEFAULT_PORT );
+    printf( "     -w=<path>   path to the server dictionary (default dict.txt)\n" );
+    printf( "     -m=<matrix> feedback matrix used in games: auto (default), full,\n" );
+    printf( "                 tiled or none\n" );
+}
+
+static void error( char *message )
+{
+    printf( "wbench: error %s\n", message );
+    help( );
+    exit(1);
+}
+
+static int get_positive_value( char *s, char option )
+{
+    if ( *s++ != '=' ) {
+        char message[64];
+        snprintf( message, sizeof(message), "missing '=' after option %c", option );
+        error( message );
+    }
+    char *end = NULL;
+    int val = (int)strtol( s, &end, 10 );
+    if ( 0 != *end || val < 1 ) {
+        char message[64];
+        snprintf( message, sizeof(message), "invalid number after option %c", option );
+        error( message );
+    }
+    return val;
+}
+
+static void get_args( int argc, char **argv, bench_args *args )
+{
+    args->n_connections = DEFAULT_CONNECTIONS;
+    args->n_requests = 0;
+    args->n_games = DEFAULT_GAMES;
+    args->strategy = ENTROPY_STRATEGY;
+    args->log = NULL;
+    args->port = DEFAULT_PORT;
+    args->dictionary = WORDLE_DICTIONARY;
+    args->matrix = AUTO_MATRIX;
+
+    char **pp = &argv[1];
+    while (--argc) {
+        char *s = *pp;
+        if (*s++ == '-') {
+            switch ( *s++ ) {
+            case 'h': case 'H':
+                help();
+                exit(0);
+            case 'c': case 'C':
+                args->n_connections = get_positive_value( s, 'c' );
+                break;
+            case 'n': case 'N':
+                args->n_requests = get_positive_value( s, 'n' );
+                break;
+            case 'g': case 'G':
+                args->n_games = get_positive_value( s, 'g' );
+                break;
+            case 'p': case 'P':
+                args->port = get_positive_value( s, 'p' );
+                break;
+            case 's': case 'S':
+                if (*s++ != '=') {
+                    error( "missing '=' after option s" );
+                }
+                if ( ! get_strategy_from_name( s, &args->strategy ) ) {
+                    error( "unknown strategy after option s" );
+                }
+                break;
+            case 'l': case 'L':
+                if (*s++ != '=') {
+                    error( "missing '=' after option l" );
+                }
+                args->log = s;
+                break;
+            case 'w': case 'W':
+                if (*s++ != '=') {
+                    error( "missing '=' after option w" );
+                }
+                args->dictionary = s;
+                break;
+            case 'm': case 'M':
+                if (*s++ != '=') {
+                    error( "missing '=' after option m" );
+                }
+                if ( ! get_matrix_type_from_name( s, &args->matrix ) ) {
+                    error( "invalid matrix type after option m" );
+                }
+                break;
+            default:
+                error( "unknown option" );
+            }
+        }
+        pp++;
+    }
+}
+
+extern int main( int argc, char **argv )
+{
+    bench_args args;
+    get_args( argc, argv, &args );
+
+    request_list rl;
+    rl.requests = NULL;
+    rl.n_requests = rl.capacity = 0;
+    if ( NULL != args.log ) {
+        load_requests( &rl, args.log );
+        printf( "Loaded %d requests from %s over %.3f s\n", rl.n_requests,
+                args.log, (double)rl.requests[rl.n_requests-1].at / 1e9 );
+    } else {
+        load_dictionary( args.dictionary );
+        thread_pool *pool = create_thread_pool( 0 );
+        init_feedback_matrix( args.matrix, pool );
+        init_suggestions( pool, 0 );
+        generate_requests( &rl, args.n_games, args.strategy );
+        printf( "Generated %d requests from %d games with strategy %s\n",
+                rl.n_requests, args.n_games, get_strategy_name( args.strategy ) );
+        discard_feedback_matrix( );
+        discard_thread_pool( pool );
+        discard_dictionary( );
+    }
+
+    run_bench( &args, &rl );
+    free( rl.requests );
+    return 0;
+}
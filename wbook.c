@@ -0,0 +1,372 @@
+
+#include <stdio.h>
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+#include <assert.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+
+#include "wdict.h"
+#include "wpos.h"
+#include "wmatrix.h"
+#include "wbook.h"
+
+/*
+    The book is made of tables of N_PATTERNS entries, one entry per feedback
+    pattern. Table i is the table of the opening word i, and a deep book has
+    one more table per entry of an opening table with a suggested word, which
+    is given by the entry. Each entry gives the candidates left as a range in
+    a single array of word indexes, the suggested word and its scores.
+
+    The book file is made of:
+    - header: the dictionary checksum, the number of openings, entries and
+      indexes and the offsets below,
+    - openings: the n_openings opening words, as indexes in dictionary,
+    - entries: the n_entries entries, table after table,
+    - indexes: the n_indexes word indexes, the candidates of the entries of a
+      table being contiguous and in increasing pattern order.
+    Values are stored in native byte order, which is checked when loading.
+*/
+
+#define BOOK_FILE_MAGIC     "WORDBOOK"
+#define BOOK_FILE_VERSION   1
+#define BOOK_BYTE_ORDER     0x01020304
+#define BOOK_FILE_ALIGNMENT 8
+#define BOOK_ARENA_SIZE     (64 * 1024)
+
+typedef struct {
+    char        magic[8];       // BOOK_FILE_MAGIC, without terminating 0
+    uint32_t    version;        // BOOK_FILE_VERSION
+    uint32_t    byte_order;     // BOOK_BYTE_ORDER
+    uint32_t    n_words;        // in dictionary
+    uint32_t    n_openings;
+    uint32_t    n_entries;      // multiple of N_PATTERNS
+    uint32_t    n_indexes;
+    uint64_t    dictionary;     // dictionary checksum
+    uint64_t    openings, entries, indexes;     // offsets
+    uint64_t    size;           // total file size
+} book_file_header;
+
+typedef struct {
+    double      entropy;        // scores of the suggested word
+    double      expected;
+    int32_t     worst;
+    int32_t     guess;          // suggested word, or -1 if none
+    uint32_t    first;          // first candidate in indexes
+    uint32_t    n_words;        // number of candidates
+    uint32_t    next;           // table after trying guess, or 0 if none
+    uint32_t    reserved;
+} book_entry;
+
+static void                     *b_map;
+static size_t                   b_map_size;
+static const book_file_header   *b_header;
+static const uint32_t           *b_openings;
+static const book_entry         *b_entries;
+static const int32_t            *b_indexes;
+
+typedef struct {
+    book_entry  *entries;
+    int         n_entries, max_entries;
+    int32_t     *indexes;
+    int         n_indexes, max_indexes;
+    arena       a;
+} book_builder;
+
+static inline uint64_t align_book_offset( uint64_t offset )
+{
+    return ( offset + BOOK_FILE_ALIGNMENT - 1 ) & ~(uint64_t)( BOOK_FILE_ALIGNMENT - 1 );
+}
+
+static void set_book_file_layout( book_file_header *h )
+{
+    h->openings = align_book_offset( sizeof( book_file_header ) );
+    h->entries = align_book_offset( h->openings + sizeof( uint32_t ) * (uint64_t)h->n_openings );
+    h->indexes = align_book_offset( h->entries + sizeof( book_entry ) * (uint64_t)h->n_entries );
+    h->size = align_book_offset( h->indexes + sizeof( int32_t ) * (uint64_t)h->n_indexes );
+}
+
+// add the table of entries for the n words split by guess and return its
+// index.
+static int add_book_table( book_builder *bb, const int *words, int n, int guess )
+{
+    if ( bb->n_entries + N_PATTERNS > bb->max_entries ) {
+        bb->max_entries = 2 * bb->max_entries + N_PATTERNS;
+        bb->entries = realloc( bb->entries, sizeof( book_entry ) * bb->max_entries );
+        assert( bb->entries );
+    }
+    if ( bb->n_indexes + n > bb->max_indexes ) {
+        bb->max_indexes = 2 * bb->max_indexes + n;
+        bb->indexes = realloc( bb->indexes, sizeof( int32_t ) * bb->max_indexes );
+        assert( bb->indexes );
+    }
+    int table = bb->n_entries / N_PATTERNS;
+    bb->n_entries += N_PATTERNS;
+    int first = bb->n_indexes;
+    bb->n_indexes += n;
+
+    int counts[N_PATTERNS] = { 0 }, start[N_PATTERNS+1];
+    for ( int i = 0; i < n; ++i ) {
+        ++counts[ get_feedback( guess, words[i] ) ];
+    }
+    start[0] = 0;
+    for ( int p = 0; p < N_PATTERNS; ++p ) {
+        start[p+1] = start[p] + counts[p];
+        counts[p] = start[p];
+    }
+    for ( int i = 0; i < n; ++i ) {     // words stay in increasing order
+        bb->indexes[ first + counts[ get_feedback( guess, words[i] ) ]++ ] = words[i];
+    }
+
+    for ( int p = 0; p < N_PATTERNS; ++p ) {
+        book_entry e;
+        memset( &e, 0, sizeof( e ) );
+        e.first = (uint32_t)( first + start[p] );
+        e.n_words = (uint32_t)( start[p+1] - start[p] );
+        e.guess = -1;
+        word_span candidates = { (int)e.n_words, &bb->indexes[e.first] };
+        suggestion best;
+        if ( 1 == get_suggestions( &candidates, ENTROPY_STRATEGY, 1, &bb->a, &best ) ) {
+            e.entropy = best.entropy;
+            e.expected = best.expected;
+            e.worst = best.worst;
+            e.guess = get_word_index( best.word );
+        }
+        reset_arena( &bb->a );
+        bb->entries[ table * N_PATTERNS + p ] = e;
+    }
+    return table;
+}
+
+extern void build_opening_book( const char *path, const char *openings,
+                                bool deep )
+{
+    assert( NO_MATRIX != get_feedback_matrix_type() );
+    int n_words = get_dictionary_size();
+    int *words = malloc( sizeof( int ) * n_words );
+    assert( words );
+    for ( int i = 0; i < n_words; ++i ) {
+        words[i] = i;
+    }
+
+    // opening words come first, then the tables of opening words, then the
+    // deeper tables, which requires adding all opening tables first.
+    int n_openings = 0, max_openings = ( strlen( openings ) + 1 ) / 2 + 1;
+    uint32_t *opening_words = malloc( sizeof( uint32_t ) * max_openings );
+    assert( opening_words );
+    if ( 0 == *openings ) {
+        printf( "wordle: no opening word given\n" );
+        exit(1);
+    }
+    // an empty opening, e.g. after a trailing comma, is rejected as any
+    // word not in dictionary
+    for ( const char *s = openings; ; ) {
+        const char *end = strchr( s, ',' );
+        size_t len = ( NULL == end ) ? strlen( s ) : (size_t)( end - s );
+        int index = ( WORD_SIZE == len ) ? get_word_index( s ) : -1;
+        if ( -1 == index ) {
+            printf( "wordle: opening '%.*s' is not in dictionary\n", (int)len, s );
+            exit(1);
+        }
+        opening_words[n_openings++] = (uint32_t)index;
+        if ( NULL == end ) {
+            break;
+        }
+        s = end + 1;
+    }
+
+    book_builder bb;
+    memset( &bb, 0, sizeof( bb ) );
+    init_arena( &bb.a, BOOK_ARENA_SIZE );
+    for ( int i = 0; i < n_openings; ++i ) {
+        add_book_table( &bb, words, n_words, opening_words[i] );
+    }
+    for ( int i = 0; deep && i < n_openings * N_PATTERNS; ++i ) {
+        if ( -1 != bb.entries[i].guess ) {
+            // entries and indexes can move when the table is added
+            int n = (int)bb.entries[i].n_words;
+            int *bucket = malloc( sizeof( int ) * n );
+            assert( bucket );
+            memcpy( bucket, &bb.indexes[ bb.entries[i].first ], sizeof( int ) * n );
+            int table = add_book_table( &bb, bucket, n, bb.entries[i].guess );
+            bb.entries[i].next = (uint32_t)table;
+            free( bucket );
+        }
+    }
+    discard_arena( &bb.a );
+
+    book_file_header h;
+    memset( &h, 0, sizeof( h ) );
+    memcpy( h.magic, BOOK_FILE_MAGIC, sizeof( h.magic ) );
+    h.version = BOOK_FILE_VERSION;
+    h.byte_order = BOOK_BYTE_ORDER;
+    h.n_words = (uint32_t)n_words;
+    h.n_openings = (uint32_t)n_openings;
+    h.n_entries = (uint32_t)bb.n_entries;
+    h.n_indexes = (uint32_t)bb.n_indexes;
+    h.dictionary = get_dictionary_checksum();
+    set_book_file_layout( &h );
+
+    uint8_t *image = calloc( h.size, 1 );
+    assert( image );
+    memcpy( image, &h, sizeof( h ) );
+    memcpy( &image[h.openings], opening_words, sizeof( uint32_t ) * h.n_openings );
+    memcpy( &image[h.entries], bb.entries, sizeof( book_entry ) * h.n_entries );
+    memcpy( &image[h.indexes], bb.indexes, sizeof( int32_t ) * h.n_indexes );
+
+    FILE *f = fopen( path, "wb" );
+    if ( NULL == f ) {
+        printf( "wordle: failed to create book file %s\n", path );
+        exit(1);
+    }
+    if ( 1 != fwrite( image, h.size, 1, f ) || 0 != fclose( f ) ) {
+        printf( "wordle: failed to write book file %s\n", path );
+        exit(1);
+    }
+    printf( "Opening book for %d words: %d tables, %llu bytes written in %s\n",
+            n_openings, bb.n_entries / N_PATTERNS, (unsigned long long)h.size, path );
+    free( image );
+    free( bb.indexes );
+    free( bb.entries );
+    free( opening_words );
+    free( words );
+}
+
+static bool is_valid_book( void )
+{
+    const book_file_header *h = b_header;
+    uint32_t n_tables = h->n_entries / N_PATTERNS;
+    for ( uint32_t i = 0; i < h->n_openings; ++i ) {
+        if ( b_openings[i] >= h->n_words ) {
+            return false;
+        }
+    }
+    for ( uint32_t i = 0; i < h->n_entries; ++i ) {
+        const book_entry *e = &b_entries[i];
+        if ( e->first > h->n_indexes || e->n_words > h->n_indexes - e->first ||
+             e->guess < -1 || e->guess >= (int32_t)h->n_words ||
+             e->next >= n_tables || ( 0 != e->next && -1 == e->guess ) ) {
+            return false;
+        }
+    }
+    for ( uint32_t i = 0; i < h->n_indexes; ++i ) {
+        if ( b_indexes[i] < 0 || b_indexes[i] >= (int32_t)h->n_words ) {
+            return false;
+        }
+    }
+    return true;
+}
+
+extern void load_opening_book( const char *path )
+{
+    discard_opening_book( );
+    FILE *f = fopen( path, "rb" );
+    if ( NULL == f ) {
+        printf( "wordle: unable to open book file %s\n", path );
+        exit(1);
+    }
+    struct stat st;
+    if ( 0 != fstat( fileno( f ), &st ) || (size_t)st.st_size < sizeof( book_file_header ) ) {
+        printf( "wordle: invalid book file %s\n", path );
+        exit(1);
+    }
+    b_map_size = (size_t)st.st_size;
+    b_map = mmap( NULL, b_map_size, PROT_READ, MAP_SHARED, fileno( f ), 0 );
+    fclose( f );    // the mapping stays valid
+    if ( MAP_FAILED == b_map ) {
+        printf( "wordle: failed to map book file %s\n", path );
+        exit(1);
+    }
+
+    const uint8_t *base = b_map;
+    b_header = b_map;
+    book_file_header expected = *b_header;
+    set_book_file_layout( &expected );
+    if ( 0 != memcmp( b_header->magic, BOOK_FILE_MAGIC, sizeof( b_header->magic ) ) ||
+         b_header->version != BOOK_FILE_VERSION ||
+         b_header->byte_order != BOOK_BYTE_ORDER ||
+         0 != b_header->n_entries % N_PATTERNS ||
+         0 == b_header->n_openings ||
+         b_header->n_openings > b_header->n_entries / N_PATTERNS ||
+         0 != memcmp( &expected, b_header, sizeof( book_file_header ) ) ||
+         b_header->size != b_map_size ) {
+        printf( "wordle: incompatible or truncated book file %s\n", path );
+        exit(1);
+    }
+    if ( b_header->n_words != (uint32_t)get_dictionary_size() ||
+         b_header->dictionary != get_dictionary_checksum() ) {
+        printf( "wordle: book file %s does not match the dictionary\n", path );
+        exit(1);
+    }
+    b_openings = (const uint32_t *)&base[b_header->openings];
+    b_entries = (const book_entry *)&base[b_header->entries];
+    b_indexes = (const int32_t *)&base[b_header->indexes];
+    if ( ! is_valid_book( ) ) {
+        printf( "wordle: corrupted book file %s\n", path );
+        exit(1);
+    }
+}
+
+extern bool get_book_answer( const char *data, book_answer *answer )
+{
+    if ( NULL == b_header ) {
+        return false;
+    }
+    size_t len = strnlen( data, 4 * WORD_SIZE + 1 );
+    if ( 2 * WORD_SIZE != len && 4 * WORD_SIZE != len ) {
+        return false;
+    }
+
+    char word[WORD_SIZE+1];
+    uint8_t pattern;
+    if ( ! get_pattern_from_data( data, word, &pattern ) ) {
+        return false;
+    }
+    int index = get_word_index( word );
+    uint32_t table = 0;
+    while ( table < b_header->n_openings && b_openings[table] != (uint32_t)index ) {
+        ++table;
+    }
+    if ( table == b_header->n_openings ) {
+        return false;
+    }
+    const book_entry *e = &b_entries[ table * N_PATTERNS + pattern ];
+    if ( 4 * WORD_SIZE == len ) {
+        if ( 0 == e->next ||
+             ! get_pattern_from_data( &data[2 * WORD_SIZE], word, &pattern ) ||
+             get_word_index( word ) != e->guess ) {
+            return false;
+        }
+        e = &b_entries[ e->next * N_PATTERNS + pattern ];
+    }
+    // no word gives that pattern, but the solver may still accept some words
+    // for it, since it only checks each letter separately.
+    if ( 0 == e->n_words ) {
+        return false;
+    }
+
+    answer->candidates.n_words = (int)e->n_words;
+    answer->candidates.indexes = (int *)&b_indexes[e->first];
+    answer->n_best = ( -1 == e->guess ) ? 0 : 1;
+    if ( -1 != e->guess ) {
+        answer->best.word = get_nth_word_in_dictionary( e->guess );
+        answer->best.entropy = e->entropy;
+        answer->best.expected = e->expected;
+        answer->best.worst = e->worst;
+    }
+    return true;
+}
+
+extern void discard_opening_book( void )
+{
+    if ( NULL != b_map ) {
+        munmap( b_map, b_map_size );
+    }
+    b_map = NULL;
+    b_header = NULL;
+    b_openings = NULL;
+    b_entries = NULL;
+    b_indexes = NULL;
+}
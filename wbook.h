@@ -0,0 +1,43 @@
+
+#ifndef __WBOOK_H__
+#define __WBOOK_H__
+
+#include <stdbool.h>
+#include "wordle.h"
+#include "wset.h"
+#include "wsuggest.h"
+
+// An opening book holds the precomputed answers to the first rows of a game:
+// for each opening word given when the book is built, and for each feedback
+// pattern (see wpos.h), the candidates left and the suggested word to try
+// next (see wsuggest.h). A deep book also holds the answers to the second row
+// when the suggested word was tried. The book file is mapped read-only in
+// memory, so that looking up an answer neither computes nor allocates
+// anything.
+
+// build the opening book for the given comma separated opening words and
+// write it in the given file. If deep is true, the book includes the second
+// row. The suggestion engine must have been initialized before (see
+// wsuggest.h), and the feedback matrix as well (see wmatrix.h).
+extern void build_opening_book( const char *path, const char *openings,
+                                bool deep );
+
+// map an opening book written by build_opening_book. The dictionary used to
+// build the book must be loaded before.
+extern void load_opening_book( const char *path );
+
+// the answer found in the book for a data string
+typedef struct {
+    word_span   candidates;     // in the book, must not be modified
+    int         n_best;         // 0 if less than 3 candidates, 1 otherwise
+    suggestion  best;           // entropy strategy
+} book_answer;
+
+// set answer with the answer for the given data string (see wsolve.h) and
+// return true if it is in the book, or return false otherwise.
+extern bool get_book_answer( const char *data, book_answer *answer );
+
+// unmap the opening book
+extern void discard_opening_book( void );
+
+#endif /* __WBOOK_H__ */
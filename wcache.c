@@ -0,0 +1,232 @@
+
+#include <stdio.h>
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdatomic.h>
+#include <pthread.h>
+#include <assert.h>
+
+#include "wcache.h"
+
+/*
+    The key is a normalized copy of the compiled constraint: the allowed masks
+    and the minimum and maximum counts of each letter, followed by the request
+    options. Counts are normalized so that equivalent constraints give the same
+    key: the maximum count of a letter cannot be more than the number of
+    positions where it is allowed, and the minimum count cannot be less than
+    the number of positions where it is the only letter allowed.
+
+    Entries are allocated once in a single array, and chained by index in
+    c_n_buckets buckets. A lookup only takes the lock in shared mode: it sets
+    the entry referenced flag, which is atomic, so that multiple threads can
+    look up entries at the same time. Insertions and evictions take the lock
+    in exclusive mode.
+*/
+
+typedef struct {
+    uint32_t    allowed[WORD_SIZE];
+    uint8_t     min_count[ALPHABET_SIZE];
+    uint8_t     max_count[ALPHABET_SIZE];
+    uint32_t    options;
+} cache_key;
+
+typedef struct {
+    cache_key   key;
+    uint32_t    hash;
+    int         next;           // next entry in the same bucket, or -1
+    char        *response;
+    int         n_candidates;   // the response is given for
+    atomic_bool referenced;     // found since the clock hand last passed
+} cache_entry;
+
+static pthread_rwlock_t c_lock = PTHREAD_RWLOCK_INITIALIZER;
+static cache_entry      *c_entries;
+static int              *c_buckets;     // first entry in bucket, or -1
+static int              c_n_buckets;    // power of 2
+static int              c_capacity, c_n_entries;
+static int              c_hand;         // next entry to check for eviction
+
+static atomic_uint_fast64_t c_hits, c_misses, c_insertions, c_evictions;
+
+static void get_cache_key( const solver_constraint *sc, uint32_t options,
+                           cache_key *key, uint32_t *hash )
+{
+    memset( key, 0, sizeof( cache_key ) );
+    key->options = options;
+    for ( int l = 0; l < ALPHABET_SIZE; ++l ) {
+        int n_allowed = 0, n_only = 0;
+        for ( int k = 0; k < WORD_SIZE; ++k ) {
+            n_allowed += ( 0 != ( sc->allowed[k] & (1u << l) ) );
+            n_only += ( sc->allowed[k] == (1u << l) );
+        }
+        key->min_count[l] = ( sc->min_count[l] > n_only ) ? sc->min_count[l] : n_only;
+        key->max_count[l] = ( sc->max_count[l] < n_allowed ) ? sc->max_count[l] : n_allowed;
+    }
+    memcpy( key->allowed, sc->allowed, sizeof( key->allowed ) );
+
+    const uint8_t *p = (const uint8_t *)key;
+    uint32_t h = 2166136261u;   // FNV-1a
+    for ( size_t i = 0; i < sizeof( cache_key ); ++i ) {
+        h = ( h ^ p[i] ) * 16777619u;
+    }
+    *hash = h;
+}
+
+// must be called with c_lock held
+static int find_entry( const cache_key *key, uint32_t hash )
+{
+    for ( int i = c_buckets[ hash & (c_n_buckets - 1) ]; -1 != i;
+                                                    i = c_entries[i].next ) {
+        if ( c_entries[i].hash == hash &&
+             0 == memcmp( &c_entries[i].key, key, sizeof( cache_key ) ) ) {
+            return i;
+        }
+    }
+    return -1;
+}
+
+// must be called with c_lock held in exclusive mode
+static void remove_entry( int index )
+{
+    int *pi = &c_buckets[ c_entries[index].hash & (c_n_buckets - 1) ];
+    while ( *pi != index ) {
+        pi = &c_entries[*pi].next;
+    }
+    *pi = c_entries[index].next;
+    free( c_entries[index].response );
+    c_entries[index].response = NULL;
+}
+
+extern void init_solver_cache( int capacity )
+{
+    discard_solver_cache( );
+    if ( capacity <= 0 ) {
+        return;
+    }
+
+    pthread_rwlock_wrlock( &c_lock );
+    c_n_buckets = 1;
+    while ( c_n_buckets < capacity ) {
+        c_n_buckets <<= 1;
+    }
+    c_buckets = malloc( sizeof( int ) * c_n_buckets );
+    c_entries = malloc( sizeof( cache_entry ) * capacity );
+    assert( c_buckets && c_entries );
+    for ( int i = 0; i < c_n_buckets; ++i ) {
+        c_buckets[i] = -1;
+    }
+    for ( int i = 0; i < capacity; ++i ) {
+        c_entries[i].response = NULL;
+        atomic_init( &c_entries[i].referenced, false );
+    }
+    c_capacity = capacity;
+    c_n_entries = 0;
+    c_hand = 0;
+    pthread_rwlock_unlock( &c_lock );
+}
+
+extern char *get_cached_response( const solver_constraint *sc,
+                                  uint32_t options, arena *a,
+                                  int *n_candidates )
+{
+    if ( 0 == c_capacity ) {
+        return NULL;
+    }
+
+    cache_key key;
+    uint32_t hash;
+    get_cache_key( sc, options, &key, &hash );
+
+    char *response = NULL;
+    pthread_rwlock_rdlock( &c_lock );
+    int index = find_entry( &key, hash );
+    if ( -1 != index ) {
+        cache_entry *ce = &c_entries[index];
+        atomic_store_explicit( &ce->referenced, true, memory_order_relaxed );
+        size_t size = strlen( ce->response ) + 1;
+        response = arena_alloc( a, size );
+        memcpy( response, ce->response, size );
+        *n_candidates = ce->n_candidates;
+    }
+    pthread_rwlock_unlock( &c_lock );
+
+    atomic_fetch_add_explicit( ( NULL == response ) ? &c_misses : &c_hits,
+                               1, memory_order_relaxed );
+    return response;
+}
+
+extern void set_cached_response( const solver_constraint *sc, uint32_t options,
+                                 const char *response, int n_candidates )
+{
+    if ( 0 == c_capacity ) {
+        return;
+    }
+
+    cache_key key;
+    uint32_t hash;
+    get_cache_key( sc, options, &key, &hash );
+    size_t size = strlen( response ) + 1;
+    char *copy = malloc( size );
+    assert( copy );
+    memcpy( copy, response, size );
+
+    pthread_rwlock_wrlock( &c_lock );
+    if ( -1 != find_entry( &key, hash ) ) {   // set by another thread
+        pthread_rwlock_unlock( &c_lock );
+        free( copy );
+        return;
+    }
+
+    int index;
+    if ( c_n_entries < c_capacity ) {
+        index = c_n_entries++;
+    } else {
+        while ( atomic_exchange_explicit( &c_entries[c_hand].referenced, false,
+                                          memory_order_relaxed ) ) {
+            c_hand = ( c_hand + 1 ) % c_capacity;
+        }
+        index = c_hand;
+        c_hand = ( c_hand + 1 ) % c_capacity;
+        remove_entry( index );
+        atomic_fetch_add_explicit( &c_evictions, 1, memory_order_relaxed );
+    }
+
+    cache_entry *ce = &c_entries[index];
+    ce->key = key;
+    ce->hash = hash;
+    ce->response = copy;
+    ce->n_candidates = n_candidates;
+    ce->next = c_buckets[ hash & (c_n_buckets - 1) ];
+    c_buckets[ hash & (c_n_buckets - 1) ] = index;
+    atomic_store_explicit( &ce->referenced, false, memory_order_relaxed );
+    pthread_rwlock_unlock( &c_lock );
+    atomic_fetch_add_explicit( &c_insertions, 1, memory_order_relaxed );
+}
+
+extern void get_solver_cache_stats( solver_cache_stats *stats )
+{
+    stats->hits = atomic_load( &c_hits );
+    stats->misses = atomic_load( &c_misses );
+    stats->insertions = atomic_load( &c_insertions );
+    stats->evictions = atomic_load( &c_evictions );
+    pthread_rwlock_rdlock( &c_lock );
+    stats->n_entries = c_n_entries;
+    stats->capacity = c_capacity;
+    pthread_rwlock_unlock( &c_lock );
+}
+
+extern void discard_solver_cache( void )
+{
+    pthread_rwlock_wrlock( &c_lock );
+    for ( int i = 0; i < c_n_entries; ++i ) {
+        free( c_entries[i].response );
+    }
+    free( c_entries );
+    free( c_buckets );
+    c_entries = NULL;
+    c_buckets = NULL;
+    c_n_buckets = c_capacity = c_n_entries = c_hand = 0;
+    pthread_rwlock_unlock( &c_lock );
+}
@@ -0,0 +1,48 @@
+
+#ifndef __WCACHE_H__
+#define __WCACHE_H__
+
+#include <stdint.h>
+#include "wordle.h"
+#include "warena.h"
+#include "wsolve.h"
+
+// The solver cache keeps the responses to solver requests, keyed by the
+// compiled constraint (see solver_constraint in wsolve.h) rather than by the
+// data string, so that different data strings giving the same constraint,
+// such as the same rows in a different order, share the same response, and
+// by the request options that change the response (as a single value). It
+// holds a fixed number of entries, and when it is full, the entry to replace
+// is selected with the CLOCK algorithm: entries found since the clock hand
+// last passed them are skipped once. All functions can be called
+// concurrently from multiple threads: lookups only take a shared lock.
+
+typedef struct {
+    uint64_t hits, misses;
+    uint64_t insertions, evictions;
+    int      n_entries, capacity;
+} solver_cache_stats;
+
+// initialize the cache for capacity entries. If capacity is 0, the cache is
+// disabled: nothing is ever found or kept.
+extern void init_solver_cache( int capacity );
+
+// return a copy of the response cached for the given constraint and options,
+// allocated in the given arena, and set n_candidates with the number of
+// candidates it was given for, or return NULL if the constraint and options
+// are not in the cache.
+extern char *get_cached_response( const solver_constraint *sc,
+                                  uint32_t options, arena *a,
+                                  int *n_candidates );
+
+// keep a copy of the response for the given constraint and options, and the
+// number of candidates it is given for, possibly replacing another entry.
+extern void set_cached_response( const solver_constraint *sc, uint32_t options,
+                                 const char *response, int n_candidates );
+
+extern void get_solver_cache_stats( solver_cache_stats *stats );
+
+// free all entries and the cache.
+extern void discard_solver_cache( void );
+
+#endif /* __WCACHE_H__ */
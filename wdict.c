@@ -4,55 +4,70 @@
 #include <stdint.h>
 #include <stdlib.h>
 #include <string.h>
+#include <stddef.h>
 #include <assert.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
 
 #include "wdict.h"
 
 /*
-    With WORD_SIZE and ALPHABET_SIZE being so small, it is possible to
-    quickly compute a unique hash for each word: 32 ^ 5 (33,554,432),
-    which can then used as an index modulo the word table size. This
-    hash value fits easily in 32 bits (4,294,967,296)
+    With WORD_SIZE and ALPHABET_SIZE being so small, each word can be packed
+    into a unique code: the first WORD_SIZE-1 letters as a base 26 number (the
+    prefix, 26 ^ 4 = 456,976 possible values) and the last letter as a single
+    bit in a 26-bit mask. The code map has one 64-bit entry per prefix: the
+    low 32 bits are the mask of last letters of the words with that prefix in
+    dictionary, and the high 32 bits are the index of the first of those
+    words. Since words are sorted in dictionary, the index of a word is that
+    first index plus the number of bits set below its last letter in the
+    mask. A lookup is therefore a single memory access with no collision to
+    resolve, and the map can be stored as is in a compiled dictionary file.
 */
-typedef struct _dict_node {
-    struct _dict_node *next;    // list only in case of modulo collisions
-    uint32_t          hash;
-    char              *word;
-} dict_node;
+#define N_WORD_PREFIXES (ALPHABET_SIZE * ALPHABET_SIZE * ALPHABET_SIZE * ALPHABET_SIZE)
 
-static dict_node *dict_table[MAX_WORD_HASH_ENTRIES];
-static char *word_table[MAX_WORD_NUMBER];
-static int  n_dict_words;
+static char     *word_store;    // all words, each one followed by a 0 byte
+static int      n_dict_words;
+static uint64_t *code_map;      // N_WORD_PREFIXES entries
+static word_columns dict_columns;
+static const uint8_t *dict_matrix;  // only from a compiled dictionary
 
-static uint32_t get_hash( const char *word )
+static word_set letter_at_position[ALPHABET_SIZE][WORD_SIZE];
+static word_set letter_count[ALPHABET_SIZE][WORD_SIZE];  // count-1
+
+static void     *dict_map;      // not NULL if loaded from a compiled file
+static size_t   dict_map_size;
+
+// return false if the word has any char outside [a-z]
+static inline bool get_code( const char *word, uint32_t *prefix, uint32_t *last )
 {
-    uint32_t hash = 0;
-    for ( int i = 0; i < WORD_SIZE; ++i ) {
-        hash |= word[i] - 'a';  // reduce from char (8 bits) to [0-25] (5 bits)
-        hash <<= 5;
+    uint32_t code = 0, invalid = 0;
+    for ( int i = 0; i < WORD_SIZE-1; ++i ) {
+        uint32_t l = (uint32_t)(unsigned char)word[i] - 'a';
+        invalid |= ( l >= ALPHABET_SIZE );
+        code = code * ALPHABET_SIZE + l;
     }
-    return hash;
+    *prefix = code;
+    *last = (uint32_t)(unsigned char)word[WORD_SIZE-1] - 'a';
+    return 0 == ( invalid | ( *last >= ALPHABET_SIZE ) );
 }
 
-static void insert_word( char *word )
+static inline const char *get_word( int index )
 {
-    uint32_t hash = get_hash( word );
-    uint32_t index = hash % (uint32_t)MAX_WORD_HASH_ENTRIES;
-    dict_node *dn = malloc( sizeof( dict_node ) );
-    assert( dn );
-    dn->hash = hash;
-    dn->word = word;
+    return &word_store[ (size_t)index * (WORD_SIZE+1) ];
+}
 
-    if ( NULL == dict_table[index] ) {
-        dn->next = NULL;
-    } else {
-        dn->next = dict_table[index];
-    }
-    dict_table[index] = dn;
-    word_table[n_dict_words] = word;
-    if ( ++n_dict_words >= MAX_WORD_NUMBER ) {
-        printf("Dictionary too large to fit in memory\n");
-        exit(1);
+static void build_code_map( void )
+{
+    code_map = calloc( N_WORD_PREFIXES, sizeof( uint64_t ) );
+    assert( code_map );
+
+    for ( int index = 0; index < n_dict_words; ++index ) {
+        uint32_t prefix, last;
+        get_code( get_word( index ), &prefix, &last );  // checked at load
+        if ( 0 == code_map[prefix] ) {
+            code_map[prefix] = (uint64_t)index << 32;
+        }
+        code_map[prefix] |= 1u << last;
     }
 }
 
@@ -61,26 +76,29 @@ extern int  get_dictionary_size( void )
     return n_dict_words;
 }
 
-extern const char *get_word_in_dictionary( const char *word )
+extern int get_word_index( const char *word )
 {
-    uint32_t hash = get_hash( word );
-    uint32_t index = hash % (uint32_t)MAX_WORD_HASH_ENTRIES;
-
-    for ( dict_node *dn = dict_table[index]; dn; dn = dn->next ) {
-        if ( hash == dn->hash ) return dn->word;
+    uint32_t prefix, last;
+    if ( NULL == code_map || ! get_code( word, &prefix, &last ) ) {
+        return -1;
     }
-    return NULL;
+    uint64_t entry = code_map[prefix];
+    uint32_t mask = (uint32_t)entry;
+    if ( 0 == ( mask & ( 1u << last ) ) ) {
+        return -1;
+    }
+    return (int)( entry >> 32 ) + __builtin_popcount( mask & ( ( 1u << last ) - 1 ) );
 }
 
-extern bool is_word_in_dictionary( const char *word )
+extern const char *get_word_in_dictionary( const char *word )
 {
-    uint32_t hash = get_hash( word );
-    uint32_t index = hash % (uint32_t)MAX_WORD_HASH_ENTRIES;
+    int index = get_word_index( word );
+    return ( -1 == index ) ? NULL : get_word( index );
+}
 
-    for ( dict_node *dn = dict_table[index]; dn; dn = dn->next ) {
-        if ( hash == dn->hash ) return true;
-    }
-    return false;
+extern bool is_word_in_dictionary( const char *word )
+{
+    return -1 != get_word_index( word );
 }
 
 typedef struct _dict_iterator {
@@ -92,10 +110,10 @@ static void reset_iterator( dict_iterator *d )
     d->index = -1;
 }
 
-static inline char *iterate_word_in_dictionary( dict_iterator *d )
+static inline const char *iterate_word_in_dictionary( dict_iterator *d )
 {
     if ( ++d->index < n_dict_words ) {
-        return word_table[d->index];
+        return get_word( d->index );
     }
     return NULL;
 }
@@ -106,7 +124,7 @@ extern void for_each_word_in_dictionary( do_fct f, void *c )
     reset_iterator( &di );
 
     while ( true ) {
-        char *word = iterate_word_in_dictionary( &di );
+        const char *word = iterate_word_in_dictionary( &di );
         if ( NULL == word )
             break;          // end iteration
 
@@ -117,44 +135,182 @@ extern void for_each_word_in_dictionary( do_fct f, void *c )
 extern const char *get_nth_word_in_dictionary( int index )
 {
     if ( index >= 0 && index < n_dict_words ) {
-        return word_table[index];
+        return get_word( index );
     }
     return NULL;
 }
 
-// note that one can have any length, but two must be exactly WORD_SIZE
-static bool do_words_share_letters( const char *one, const char *two )
+static inline int get_column_capacity( int capacity )
 {
-    for ( int i = 0; i < WORD_SIZE; ++i ) {
-        if ( NULL != strchr( one, two[i] ) ) {
-            return true;
+    capacity = ( (capacity + COLUMN_ALIGNMENT - 1) / COLUMN_ALIGNMENT )
+                                                        * COLUMN_ALIGNMENT;
+    return ( 0 == capacity ) ? COLUMN_ALIGNMENT : capacity;
+}
+
+// a single block for all columns followed by all letter masks
+static inline size_t get_column_block_size( int capacity )
+{
+    return (size_t)capacity * ( WORD_SIZE + sizeof(uint32_t) );
+}
+
+static void set_column_block( word_columns *wc, char *block, int capacity )
+{
+    memset( block, 0, get_column_block_size( capacity ) );
+    for ( int k = 0; k < WORD_SIZE; ++k ) {
+        wc->column[k] = &block[ capacity * k ];
+    }
+    wc->letters = (uint32_t *)&block[ capacity * WORD_SIZE ];
+    wc->capacity = capacity;
+    wc->n_words = 0;
+}
+
+extern void init_word_columns( word_columns *wc, int capacity )
+{
+    capacity = get_column_capacity( capacity );
+    char *block = aligned_alloc( COLUMN_ALIGNMENT,
+                                 get_column_block_size( capacity ) );
+    assert( block );
+    set_column_block( wc, block, capacity );
+}
+
+extern void init_word_columns_in_arena( word_columns *wc, int capacity,
+                                        arena *a )
+{
+    capacity = get_column_capacity( capacity );
+    char *block = arena_alloc_aligned( a, get_column_block_size( capacity ),
+                                       COLUMN_ALIGNMENT );
+    set_column_block( wc, block, capacity );
+}
+
+extern void set_word_columns( word_columns *wc, const int *indexes, int n )
+{
+    assert( n <= wc->capacity );
+    for ( int i = 0; i < n; ++i ) {
+        const char *word = get_word( ( NULL == indexes ) ? i : indexes[i] );
+        uint32_t letters = 0;
+        for ( int k = 0; k < WORD_SIZE; ++k ) {
+            wc->column[k][i] = word[k];
+            letters |= 1u << (word[k] - 'a');
+        }
+        wc->letters[i] = letters;
+    }
+    if ( n < wc->n_words ) {    // clear padding left by a previous use
+        for ( int k = 0; k < WORD_SIZE; ++k ) {
+            memset( &wc->column[k][n], 0, wc->n_words - n );
         }
+        memset( &wc->letters[n], 0, sizeof(uint32_t) * (wc->n_words - n) );
     }
-    return false;
+    wc->n_words = n;
 }
 
-extern word_node *get_all_words_in_dict_not_sharing_letters( const char *letters )
+extern void discard_word_columns( word_columns *wc )
 {
-    word_node *root = NULL;
+    if ( NULL != wc->column[0] ) {
+        free( wc->column[0] );
+    }
+    for ( int k = 0; k < WORD_SIZE; ++k ) {
+        wc->column[k] = NULL;
+    }
+    wc->letters = NULL;
+    wc->n_words = wc->capacity = 0;
+}
 
-    dict_iterator di;
-    reset_iterator( &di );
-    while ( true ) {
-        char *word = iterate_word_in_dictionary( &di );
-        if ( NULL == word )
-            break;          // end iteration
+extern const word_columns *get_dictionary_columns( void )
+{
+    return &dict_columns;
+}
+
+static void build_dictionary_index( void )
+{
+    for ( int l = 0; l < ALPHABET_SIZE; ++l ) {
+        for ( int k = 0; k < WORD_SIZE; ++k ) {
+            init_word_set( &letter_at_position[l][k], n_dict_words );
+            init_word_set( &letter_count[l][k], n_dict_words );
+        }
+    }
+    for ( int i = 0; i < n_dict_words; ++i ) {
+        int count[ALPHABET_SIZE] = { 0 };
+        for ( int k = 0; k < WORD_SIZE; ++k ) {
+            int l = get_word( i )[k] - 'a';
+            add_to_word_set( &letter_at_position[l][k], i );
+            add_to_word_set( &letter_count[l][count[l]++], i );
+        }
+    }
+}
 
-        if ( NULL != letters && do_words_share_letters( letters, word ) )
-            continue;       // skip words sharing letters
+static void discard_dictionary_index( void )
+{
+    for ( int l = 0; l < ALPHABET_SIZE; ++l ) {
+        for ( int k = 0; k < WORD_SIZE; ++k ) {
+            discard_word_set( &letter_at_position[l][k] );
+            discard_word_set( &letter_count[l][k] );
+        }
+    }
+}
+
+extern const word_set *get_letter_at_position_set( int letter, int position )
+{
+    assert( letter >= 0 && letter < ALPHABET_SIZE );
+    assert( position >= 0 && position < WORD_SIZE );
+    return &letter_at_position[letter][position];
+}
+
+extern const word_set *get_letter_count_set( int letter, int count )
+{
+    assert( letter >= 0 && letter < ALPHABET_SIZE );
+    assert( count > 0 && count <= WORD_SIZE );
+    return &letter_count[letter][count-1];
+}
+
+// letters can have any length
+static uint32_t get_letter_mask( const char *letters )
+{
+    uint32_t mask = 0;
+    for ( ; letters && *letters; ++letters ) {
+        mask |= 1u << (*letters - 'a');
+    }
+    return mask;
+}
+
+extern void get_words_in_dict_not_sharing_letters( const char *letters,
+                                                   arena *a, word_span *span )
+{
+    uint32_t mask = get_letter_mask( letters );
+
+    // allocate for the worst case, the end of the span is simply not used
+    span->indexes = arena_alloc( a, sizeof( int ) * n_dict_words );
+    span->n_words = 0;
+    for ( int index = 0; index < n_dict_words; ++index ) {
+        if ( 0 == ( dict_columns.letters[index] & mask ) ) {
+            span->indexes[span->n_words++] = index;
+        }
+    }
+}
 
+extern word_node *get_word_list_from_span( const word_span *span )
+{
+    word_node *root = NULL;
+    for ( int i = 0; i < span->n_words; ++i ) {
         word_node *wn = malloc( sizeof( word_node ) );
-        wn->word = word;
+        assert( wn );
+        wn->word = get_word( span->indexes[i] );
         wn->next = root;
         root = wn;
     }
     return root;
 }
 
+extern word_node *get_all_words_in_dict_not_sharing_letters( const char *letters )
+{
+    arena a;
+    init_arena( &a, sizeof( int ) * ( n_dict_words + 1 ) );
+    word_span span;
+    get_words_in_dict_not_sharing_letters( letters, &a, &span );
+    word_node *root = get_word_list_from_span( &span );
+    discard_arena( &a );
+    return root;
+}
+
 extern size_t get_word_count( word_node *words )
 {
     size_t count = 0;
@@ -181,7 +337,7 @@ extern word_node *get_all_words_in_dict( void )
     dict_iterator di;
     reset_iterator( &di );
     while ( true ) {
-        char *word = iterate_word_in_dictionary( &di );
+        const char *word = iterate_word_in_dictionary( &di );
         if ( NULL == word )
             break;
 
@@ -192,35 +348,214 @@ extern word_node *get_all_words_in_dict( void )
     }
     return root;
 }
+#endif
+
+/*
+    A compiled dictionary file is a memory image of the loaded dictionary,
+    which is mapped read-only and used in place, without any parsing or
+    copy. Since the mapping is shared, all processes using the same file
+    share the same physical pages.
+
+    The file starts with a dict_file_header, followed by sections at offsets
+    aligned on DICT_FILE_ALIGNMENT bytes:
+    - words: n_words words of WORD_SIZE letters each followed by a 0 byte,
+    - codes: the code map of n_prefixes uint64_t entries,
+    - columns: the dictionary columns, WORD_SIZE columns of capacity bytes
+      followed by capacity uint32_t letter masks (see word_columns),
+    - index: the n_blocks uint64_t of each letter_at_position set, then of
+      each letter_count set, in [letter][position] and [letter][count] order,
+    - matrix (optional): n_words * n_words feedback patterns in the layout of
+      a FULL_MATRIX (see wmatrix.h).
+    Values are stored in native byte order, which is checked when loading.
+    The checksum covers the header up to the checksum and the words, from
+    which all other sections are built: checking it at load time only reads
+    the first pages of the file, the other pages are read when used.
+*/
+#define DICT_FILE_MAGIC     "WORDLEDB"
+#define DICT_FILE_VERSION   3
+#define DICT_BYTE_ORDER     0x01020304
+#define DICT_FILE_ALIGNMENT 64
+
+typedef struct {
+    char        magic[8];       // DICT_FILE_MAGIC, without terminating 0
+    uint32_t    version;        // DICT_FILE_VERSION
+    uint32_t    byte_order;     // DICT_BYTE_ORDER
+    uint32_t    word_size;      // WORD_SIZE
+    uint32_t    n_words;
+    uint32_t    n_prefixes;     // N_WORD_PREFIXES
+    uint32_t    capacity;       // column capacity
+    uint32_t    n_blocks;       // blocks per word set
+    uint32_t    reserved;
+    uint64_t    words, codes, columns, index, matrix;   // offsets, matrix is
+                                                        // 0 if not included
+    uint64_t    size;           // total file size
+    uint64_t    checksum;
+} dict_file_header;
+
+static inline uint64_t align_offset( uint64_t offset )
+{
+    return ( offset + DICT_FILE_ALIGNMENT - 1 ) & ~(uint64_t)( DICT_FILE_ALIGNMENT - 1 );
+}
 
-static void get_dictionary_table_collisions( collisions *c )
+// FNV-1a, 8 bytes at a time, from the given checksum. size must be a
+// multiple of 8 bytes.
+static uint64_t get_checksum( uint64_t checksum, const uint8_t *data,
+                              uint64_t size )
 {
-    c->n_collisions = 0;
-    c->max_collision_chain = 0;
+    for ( uint64_t i = 0; i < size; i += sizeof( uint64_t ) ) {
+        uint64_t value;
+        memcpy( &value, &data[i], sizeof( uint64_t ) );
+        checksum = ( checksum ^ value ) * 1099511628211u;
+    }
+    return checksum;
+}
 
-    for ( int i = 0; i < MAX_WORD_HASH_ENTRIES; ++i ) {
-        if ( NULL != dict_table[i] ) {
-            int chain = 0;
-            for (  dict_node *dn = dict_table[i]; dn; dn = dn->next ) {
-                ++chain;
-            }
-            if ( chain > 1 ) {
-                ++c->n_collisions;
-                if ( c->max_collision_chain < (chain-1) )
-                    c->max_collision_chain = chain-1;
-            }
+// words are padded with 0 up to the codes, at an aligned offset
+static uint64_t get_file_checksum( const dict_file_header *h,
+                                   const uint8_t *words )
+{
+    uint64_t checksum = get_checksum( 14695981039346656037u, (const uint8_t *)h,
+                                      offsetof( dict_file_header, checksum ) );
+    return get_checksum( checksum, words, h->codes - h->words );
+}
+
+static void set_dict_file_layout( dict_file_header *h, bool with_matrix )
+{
+    memset( h, 0, sizeof( dict_file_header ) );
+    memcpy( h->magic, DICT_FILE_MAGIC, sizeof( h->magic ) );
+    h->version = DICT_FILE_VERSION;
+    h->byte_order = DICT_BYTE_ORDER;
+    h->word_size = WORD_SIZE;
+    h->n_words = (uint32_t)n_dict_words;
+    h->n_prefixes = N_WORD_PREFIXES;
+    h->capacity = (uint32_t)dict_columns.capacity;
+    h->n_blocks = (uint32_t)letter_at_position[0][0].n_blocks;
+
+    uint64_t words_size = (uint64_t)h->n_words * (WORD_SIZE+1);
+    uint64_t codes_size = (uint64_t)h->n_prefixes * sizeof( uint64_t );
+    uint64_t columns_size = (uint64_t)h->capacity * ( WORD_SIZE + sizeof( uint32_t ) );
+    uint64_t index_size = 2 * ALPHABET_SIZE * WORD_SIZE *
+                                    (uint64_t)h->n_blocks * sizeof( uint64_t );
+    uint64_t matrix_size = (uint64_t)h->n_words * h->n_words;
+
+    h->words = align_offset( sizeof( dict_file_header ) );
+    h->codes = align_offset( h->words + words_size );
+    h->columns = align_offset( h->codes + codes_size );
+    h->index = align_offset( h->columns + columns_size );
+    h->size = align_offset( h->index + index_size );
+    if ( with_matrix ) {
+        h->matrix = h->size;
+        h->size = align_offset( h->matrix + matrix_size );
+    }
+}
+
+extern void save_dictionary( const char *path, const uint8_t *matrix )
+{
+    dict_file_header h;
+    set_dict_file_layout( &h, NULL != matrix );
+
+    uint8_t *image = calloc( h.size, 1 );
+    assert( image );
+    memcpy( &image[h.words], word_store, (size_t)n_dict_words * (WORD_SIZE+1) );
+    memcpy( &image[h.codes], code_map, N_WORD_PREFIXES * sizeof( uint64_t ) );
+    memcpy( &image[h.columns], dict_columns.column[0],
+            (size_t)h.capacity * ( WORD_SIZE + sizeof( uint32_t ) ) );
+
+    size_t set_size = (size_t)h.n_blocks * sizeof( uint64_t );
+    uint8_t *p = &image[h.index];
+    for ( int l = 0; l < ALPHABET_SIZE; ++l ) {
+        for ( int k = 0; k < WORD_SIZE; ++k, p += set_size ) {
+            memcpy( p, letter_at_position[l][k].bits, set_size );
+        }
+    }
+    for ( int l = 0; l < ALPHABET_SIZE; ++l ) {
+        for ( int k = 0; k < WORD_SIZE; ++k, p += set_size ) {
+            memcpy( p, letter_count[l][k].bits, set_size );
         }
     }
+    if ( NULL != matrix ) {
+        memcpy( &image[h.matrix], matrix, (size_t)n_dict_words * n_dict_words );
+    }
+    h.checksum = get_file_checksum( &h, &image[h.words] );
+    memcpy( image, &h, sizeof(h) );
+
+    FILE *f = fopen( path, "wb" );
+    if ( NULL == f ) {
+        printf( "wordle: failed to create dictionary file %s\n", path );
+        exit(1);
+    }
+    if ( 1 != fwrite( image, h.size, 1, f ) || 0 != fclose( f ) ) {
+        printf( "wordle: failed to write dictionary file %s\n", path );
+        exit(1);
+    }
+    free( image );
 }
 
-extern void print_collisions( void )
+static void map_dictionary( const char *path, FILE *f )
 {
-    collisions col_stats;
-    get_dictionary_table_collisions( &col_stats );
-    printf("Number of collisions: %d max collision chain: %d\n",
-            col_stats.n_collisions, col_stats.max_collision_chain );
+    struct stat st;
+    if ( 0 != fstat( fileno( f ), &st ) || (size_t)st.st_size < sizeof( dict_file_header ) ) {
+        printf( "wordle: invalid dictionary file %s\n", path );
+        exit(1);
+    }
+    dict_map_size = (size_t)st.st_size;
+    dict_map = mmap( NULL, dict_map_size, PROT_READ, MAP_SHARED, fileno( f ), 0 );
+    fclose( f );    // the mapping stays valid
+    if ( MAP_FAILED == dict_map ) {
+        printf( "wordle: failed to map dictionary file %s\n", path );
+        exit(1);
+    }
+
+    const uint8_t *base = dict_map;
+    const dict_file_header *h = dict_map;
+    dict_file_header expected;
+    n_dict_words = (int)h->n_words;
+    dict_columns.capacity = (int)h->capacity;
+    letter_at_position[0][0].n_blocks = (int)h->n_blocks;
+    set_dict_file_layout( &expected, 0 != h->matrix );
+
+    if ( h->version != DICT_FILE_VERSION || h->byte_order != DICT_BYTE_ORDER ||
+         h->word_size != WORD_SIZE || h->n_words > MAX_WORD_NUMBER ||
+         h->n_prefixes != N_WORD_PREFIXES || h->capacity < h->n_words ||
+         h->n_blocks != ( h->n_words + 63 ) / 64 ||
+         0 != memcmp( &expected, h, offsetof( dict_file_header, checksum ) ) ||
+         h->size != dict_map_size ) {
+        printf( "wordle: incompatible or truncated dictionary file %s\n", path );
+        exit(1);
+    }
+    if ( h->checksum != get_file_checksum( h, &base[h->words] ) ) {
+        printf( "wordle: corrupted dictionary file %s\n", path );
+        exit(1);
+    }
+
+    // the mapping is read-only: the pointers below are never written through
+    word_store = (char *)&base[h->words];
+    code_map = (uint64_t *)&base[h->codes];
+    for ( int k = 0; k < WORD_SIZE; ++k ) {
+        dict_columns.column[k] = (char *)&base[h->columns + (uint64_t)h->capacity * k];
+    }
+    dict_columns.letters = (uint32_t *)&base[h->columns + (uint64_t)h->capacity * WORD_SIZE];
+    dict_columns.n_words = n_dict_words;
+
+    uint64_t *bits = (uint64_t *)&base[h->index];
+    for ( int l = 0; l < ALPHABET_SIZE; ++l ) {
+        for ( int k = 0; k < WORD_SIZE; ++k, bits += h->n_blocks ) {
+            letter_at_position[l][k] = (word_set){ n_dict_words, (int)h->n_blocks, bits };
+        }
+    }
+    for ( int l = 0; l < ALPHABET_SIZE; ++l ) {
+        for ( int k = 0; k < WORD_SIZE; ++k, bits += h->n_blocks ) {
+            letter_count[l][k] = (word_set){ n_dict_words, (int)h->n_blocks, bits };
+        }
+    }
+    dict_matrix = ( 0 != h->matrix ) ? &base[h->matrix] : NULL;
 }
-#endif
+
+static int compare_words( const void *a, const void *b )
+{
+    return strcmp( a, b );
+}
+
 extern void load_dictionary( const char *path )
 {
     FILE *f = fopen( path, "rb" );
@@ -229,32 +564,86 @@ extern void load_dictionary( const char *path )
         exit(1);
     }
 
+    char magic[sizeof(DICT_FILE_MAGIC)-1];
+    if ( sizeof(magic) == fread( magic, 1, sizeof(magic), f ) &&
+         0 == memcmp( magic, DICT_FILE_MAGIC, sizeof(magic) ) ) {
+        map_dictionary( path, f );
+        return;
+    }
+    rewind( f );
+
+    // words are stored contiguously in a single block, in dictionary order
+    word_store = malloc( MAX_WORD_NUMBER * (WORD_SIZE+1) );
+    assert( word_store );
+    bool sorted = true;
     while ( ! feof( f ) ) {
-        char *word = malloc( WORD_SIZE+1 );
+        char *word = &word_store[ n_dict_words * (WORD_SIZE+1) ];
         if ( 1 != fscanf( f, "%5s", word ) ) {
-            free(word);
             break;
         }
-        // assumes words are in lower case, only [a-z] chars
-        insert_word( word );
+        uint32_t prefix, last;
+        if ( strlen( word ) != WORD_SIZE || ! get_code( word, &prefix, &last ) ) {
+            printf( "wordle: invalid word %s in dictionary %s\n", word, path );
+            exit(1);
+        }
+        if ( n_dict_words > 0 && strcmp( get_word( n_dict_words-1 ), word ) >= 0 ) {
+            sorted = false;
+        }
+        if ( ++n_dict_words >= MAX_WORD_NUMBER ) {
+            printf("Dictionary too large to fit in memory\n");
+            exit(1);
+        }
     }
     fclose( f );
+
+    // the code map requires sorted words without duplicates
+    if ( ! sorted ) {
+        qsort( word_store, n_dict_words, WORD_SIZE+1, compare_words );
+        int n = 0;
+        for ( int i = 0; i < n_dict_words; ++i ) {
+            if ( 0 == n || 0 != strcmp( get_word( n-1 ), get_word( i ) ) ) {
+                memmove( &word_store[ n++ * (WORD_SIZE+1) ], get_word( i ), WORD_SIZE+1 );
+            }
+        }
+        n_dict_words = n;
+    }
+    build_code_map( );
+    init_word_columns( &dict_columns, n_dict_words );
+    set_word_columns( &dict_columns, NULL, n_dict_words );
+    build_dictionary_index( );
 }
 
-extern void discard_dictionary( void )
+extern const uint8_t *get_dictionary_matrix( void )
 {
-    for ( int index = 0; index < MAX_WORD_HASH_ENTRIES; ++index ) {
-        dict_node *next;
-        for ( dict_node *dn = dict_table[index]; dn; dn = next ) {
-            next = dn->next;
-            free( dn->word );
-            free( dn );
-        }
-        dict_table[index] = NULL;
+    return dict_matrix;
+}
+
+extern uint64_t get_dictionary_checksum( void )
+{
+    uint64_t checksum = 14695981039346656037u;     // FNV-1a
+    const uint8_t *p = (const uint8_t *)word_store;
+    for ( size_t i = 0; i < (size_t)n_dict_words * (WORD_SIZE+1); ++i ) {
+        checksum = ( checksum ^ p[i] ) * 1099511628211u;
     }
-    for ( int index = 0; index < n_dict_words; ++index ) {
-        word_table[index] = NULL;
+    return checksum;
+}
+
+extern void discard_dictionary( void )
+{
+    if ( NULL != dict_map ) {
+        munmap( dict_map, dict_map_size );
+        dict_map = NULL;
+        memset( &dict_columns, 0, sizeof( dict_columns ) );
+        memset( letter_at_position, 0, sizeof( letter_at_position ) );
+        memset( letter_count, 0, sizeof( letter_count ) );
+        dict_matrix = NULL;
+    } else {
+        free( word_store );
+        free( code_map );
+        discard_word_columns( &dict_columns );
+        discard_dictionary_index( );
     }
+    word_store = NULL;
+    code_map = NULL;
     n_dict_words = 0;
 }
-
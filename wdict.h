@@ -3,11 +3,31 @@
 #define __WDICT_H__
 
 #include <stdbool.h>
+#include <stdint.h>
 #include "wordle.h"
+#include "wset.h"
 
-// load wordle dictionary in memory
+// load wordle dictionary in memory, either from a text file with one word
+// per line, or from a compiled dictionary file (see save_dictionary), which
+// is mapped read-only in memory and used in place. Words in a text file are
+// sorted and duplicates removed if needed, so that dictionary order is
+// always alphabetical order.
 extern void load_dictionary( const char *path );
 
+// write the currently loaded dictionary as a compiled dictionary file,
+// including the given feedback matrix if not NULL. The matrix must have the
+// layout of a FULL_MATRIX (see wmatrix.h). The compiled file is only valid
+// for the machine architecture it was written on.
+extern void save_dictionary( const char *path, const uint8_t *matrix );
+
+// return the feedback matrix stored in the compiled dictionary file, or NULL
+// if the dictionary was not loaded from a compiled file with a matrix.
+extern const uint8_t *get_dictionary_matrix( void );
+
+// return a checksum of all words in dictionary order, which allows checking
+// that a file built for a dictionary is used with the same dictionary.
+extern uint64_t get_dictionary_checksum( void );
+
 // unload the whole wordle dictionary
 extern void discard_dictionary( void );
 
@@ -15,6 +35,11 @@ extern void discard_dictionary( void );
 // does not exist in the dictionary.
 extern const char *get_word_in_dictionary( const char *word );
 
+// return the index of the word in dictionary (see get_nth_word_in_dictionary)
+// or -1 if the given word does not exist in the dictionary. This is a single
+// lookup in memory, and any string of at least WORD_SIZE chars is accepted.
+extern int get_word_index( const char *word );
+
 // return true if the word exists in the dictionary
 extern bool is_word_in_dictionary( const char *word );
 
@@ -27,11 +52,22 @@ extern int  get_dictionary_size( void );
 // discard_dictionary.
 extern const char *get_nth_word_in_dictionary( int index );
 
+// set span with the indexes of all words in dictionary that do not include
+// any letter in a given string (of any length). The span is allocated in the
+// given arena (see wset.h).
+extern void get_words_in_dict_not_sharing_letters( const char *letters,
+                                                   arena *a, word_span *span );
+
 // return the list of words in dictionary that do not include any letter in
 // a given string (of any length). The result is a word_node list that must
 // be freed by the caller after use, by calling free_word_list
 extern word_node *get_all_words_in_dict_not_sharing_letters( const char *letters );
 
+// return a word_node list with the words in span, in the reverse order of
+// the span. The list must be freed by the caller after use, by calling
+// free_word_list
+extern word_node *get_word_list_from_span( const word_span *span );
+
 // return the number of words in a list
 extern size_t get_word_count( word_node *list );
 
@@ -39,14 +75,51 @@ extern size_t get_word_count( word_node *list );
 // and will stay available until discard_dictionary is called.
 extern void free_word_list( word_node *list );
  
-typedef void (*do_fct)( void *ctxt, const char *word );
-extern void for_each_word_in_dictionary( do_fct f, void *ctxt );
+// Structure of arrays copy of a set of words: one column of letters per
+// position, so that the letters at the same position in consecutive words
+// are contiguous in memory, and the set of letters in each word as a mask
+// (bit 0 for 'a' to bit 25 for 'z'). Columns and masks are aligned on
+// COLUMN_ALIGNMENT bytes and padded with 0 up to a multiple of COLUMN_ALIGNMENT
+// words, so that they can be read by blocks without checking for the end.
+#define COLUMN_ALIGNMENT    32
 
 typedef struct {
-    int n_collisions;
-    int max_collision_chain;
-} collisions;
+    int      n_words;
+    int      capacity;              // multiple of COLUMN_ALIGNMENT
+    char     *column[WORD_SIZE];    // column[k][i]: letter k in word i
+    uint32_t *letters;              // letters[i]: letters in word i
+} word_columns;
 
-extern void get_dictionary_table_collisions( collisions *c );
+// allocate columns for up to capacity words
+extern void init_word_columns( word_columns *wc, int capacity );
+
+// same as init_word_columns, in the given arena: the columns must not be
+// discarded, they are freed with the arena.
+extern void init_word_columns_in_arena( word_columns *wc, int capacity,
+                                        arena *a );
+
+// fill columns with the n words at the given dictionary indexes, or with the
+// first n words in dictionary if indexes is NULL. n must not be larger than
+// the capacity given to init_word_columns.
+extern void set_word_columns( word_columns *wc, const int *indexes, int n );
+
+extern void discard_word_columns( word_columns *wc );
+
+// return the columns for the whole dictionary, which are built when loading
+// the dictionary.
+extern const word_columns *get_dictionary_columns( void );
+
+// The dictionary index is made of word sets (see wset.h) built when loading
+// the dictionary:
+// - for each letter [0-25] and position [0-4], the set of words with that
+//   letter at that position,
+// - for each letter [0-25] and count [1-5], the set of words with at least
+//   count instances of that letter.
+// The returned sets must not be modified or freed by the caller.
+extern const word_set *get_letter_at_position_set( int letter, int position );
+extern const word_set *get_letter_count_set( int letter, int count );
+
+typedef void (*do_fct)( void *ctxt, const char *word );
+extern void for_each_word_in_dictionary( do_fct f, void *ctxt );
 
 #endif /* __WDICT_H__ */
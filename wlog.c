@@ -0,0 +1,291 @@
+
+#include <stdio.h>
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdarg.h>
+#include <stdatomic.h>
+#include <time.h>
+#include <pthread.h>
+#include <assert.h>
+
+#include "wlog.h"
+
+/*
+    Each ring buffer has a single writer, the thread owning it, and a single
+    reader, the log thread. The writer only moves head, after the record is
+    complete, and the reader only moves tail, after the record is written to
+    the file, so that no lock is needed: head and tail are free running
+    counters, and the ring is full when head - tail is LOG_RING_SIZE.
+
+    Ring buffers are allocated on the first message logged by a thread, and
+    added to a list that is never shortened until the log is discarded. When
+    a thread exits, its ring buffer is released and it is taken by the next
+    thread that needs one.
+*/
+
+#define CACHE_LINE  64
+
+typedef struct {
+    time_t      seconds;
+    long        nanoseconds;
+    log_level   level;
+    char        message[LOG_MESSAGE_SIZE];
+} log_record;
+
+typedef struct _log_ring {
+    _Alignas(CACHE_LINE) atomic_uint head;  // next record to write
+    _Alignas(CACHE_LINE) atomic_uint tail;  // next record to read
+    _Alignas(CACHE_LINE) struct _log_ring *next;
+    atomic_bool     in_use;                 // owned by a thread
+    atomic_ulong    dropped;                // records
+    int             id;                     // thread number in the file
+    log_record      records[LOG_RING_SIZE];
+} log_ring;
+
+static const char *s_level_names[] = { "error", "warning", "info", "debug" };
+
+static log_level            s_level = LOG_INFO;
+static unsigned int         s_sampling = 1;
+static FILE                 *s_file;
+static atomic_bool          s_started;
+static _Atomic(log_ring *)  s_rings;
+static atomic_int           s_n_rings;
+static pthread_key_t        s_key;          // to release a ring at thread exit
+static atomic_ullong        s_written;
+static unsigned long long   s_reported;     // dropped records already reported
+static unsigned long long   s_discarded;    // dropped in discarded rings
+
+static pthread_t            s_thread;
+static pthread_mutex_t      s_lock = PTHREAD_MUTEX_INITIALIZER;
+static pthread_cond_t       s_wakeup = PTHREAD_COND_INITIALIZER;
+static bool                 s_stop;
+
+static _Thread_local log_ring       *t_ring;
+static _Thread_local unsigned int   t_n_requests;
+
+extern bool get_log_level_from_name( const char *name, log_level *level )
+{
+    for ( int i = LOG_ERROR; i <= LOG_DEBUG; ++i ) {
+        if ( 0 == strcmp( name, s_level_names[i] ) ) {
+            *level = (log_level)i;
+            return true;
+        }
+    }
+    return false;
+}
+
+static void release_ring( void *ring )
+{
+    log_ring *r = ring;
+    atomic_store_explicit( &r->in_use, false, memory_order_release );
+}
+
+// return the ring buffer owned by the calling thread, or NULL if none could
+// be allocated.
+static log_ring *get_ring( void )
+{
+    if ( NULL != t_ring ) {
+        return t_ring;
+    }
+    for ( log_ring *r = atomic_load( &s_rings ); NULL != r; r = r->next ) {
+        bool free_ring = false;
+        if ( atomic_compare_exchange_strong( &r->in_use, &free_ring, true ) ) {
+            t_ring = r;
+            break;
+        }
+    }
+    if ( NULL == t_ring ) {
+        log_ring *r = aligned_alloc( CACHE_LINE, sizeof(log_ring) );
+        if ( NULL == r ) {
+            return NULL;
+        }
+        atomic_init( &r->head, 0 );
+        atomic_init( &r->tail, 0 );
+        atomic_init( &r->in_use, true );
+        atomic_init( &r->dropped, 0 );
+        r->id = atomic_fetch_add( &s_n_rings, 1 ) + 1;
+        r->next = atomic_load( &s_rings );
+        while ( ! atomic_compare_exchange_weak( &s_rings, &r->next, r ) ) {
+        }
+        t_ring = r;
+    }
+    pthread_setspecific( s_key, t_ring );
+    return t_ring;
+}
+
+static void add_record( log_ring *r, log_level level, const char *format,
+                        va_list args )
+{
+    unsigned int head = atomic_load_explicit( &r->head, memory_order_relaxed );
+    unsigned int tail = atomic_load_explicit( &r->tail, memory_order_acquire );
+    if ( LOG_RING_SIZE == head - tail ) {
+        atomic_fetch_add_explicit( &r->dropped, 1, memory_order_relaxed );
+        return;
+    }
+
+    log_record *lr = &r->records[ head & ( LOG_RING_SIZE - 1 ) ];
+    struct timespec now;
+    clock_gettime( CLOCK_REALTIME, &now );
+    lr->seconds = now.tv_sec;
+    lr->nanoseconds = now.tv_nsec;
+    lr->level = level;
+    if ( LOG_MESSAGE_SIZE <= vsnprintf( lr->message, LOG_MESSAGE_SIZE, format, args ) ) {
+        memcpy( &lr->message[LOG_MESSAGE_SIZE-4], "...", 4 );
+    }
+    atomic_store_explicit( &r->head, head + 1, memory_order_release );
+}
+
+extern void log_message( log_level level, const char *format, ... )
+{
+    if ( level > s_level ) {
+        return;
+    }
+    va_list args;
+    va_start( args, format );
+    if ( atomic_load_explicit( &s_started, memory_order_acquire ) ) {
+        log_ring *r = get_ring( );
+        if ( NULL != r ) {
+            add_record( r, level, format, args );
+        }
+    } else {
+        vprintf( format, args );
+        printf( "\n" );
+    }
+    va_end( args );
+}
+
+extern bool is_log_enabled( log_level level )
+{
+    return level <= s_level;
+}
+
+extern bool sample_log( void )
+{
+    if ( LOG_DEBUG > s_level ) {
+        return false;
+    }
+    return 0 == t_n_requests++ % s_sampling;
+}
+
+static void write_record( int id, const log_record *lr )
+{
+    struct tm tm;
+    localtime_r( &lr->seconds, &tm );
+    char date[32];
+    strftime( date, sizeof(date), "%Y-%m-%d %H:%M:%S", &tm );
+    fprintf( s_file, "%s.%06ld %-7s t%-2d %s\n", date, lr->nanoseconds / 1000,
+             s_level_names[lr->level], id, lr->message );
+}
+
+// write all records available in all rings, and the number of records
+// dropped since the last call if any.
+static void write_records( void )
+{
+    unsigned long long n_written = 0, n_dropped = 0;
+    for ( log_ring *r = atomic_load( &s_rings ); NULL != r; r = r->next ) {
+        unsigned int tail = atomic_load_explicit( &r->tail, memory_order_relaxed );
+        unsigned int head = atomic_load_explicit( &r->head, memory_order_acquire );
+        for ( ; tail != head; ++tail ) {
+            write_record( r->id, &r->records[ tail & ( LOG_RING_SIZE - 1 ) ] );
+            ++n_written;
+        }
+        atomic_store_explicit( &r->tail, tail, memory_order_release );
+        n_dropped += atomic_load_explicit( &r->dropped, memory_order_relaxed );
+    }
+    if ( n_dropped > s_reported ) {
+        fprintf( s_file, "log: %llu message(s) dropped\n", n_dropped - s_reported );
+        s_reported = n_dropped;
+    }
+    if ( 0 != n_written ) {
+        atomic_fetch_add( &s_written, n_written );
+        fflush( s_file );
+    }
+}
+
+static void *log_thread( void *arg )
+{
+    (void)arg;
+    pthread_mutex_lock( &s_lock );
+    while ( ! s_stop ) {
+        struct timespec until;
+        clock_gettime( CLOCK_REALTIME, &until );
+        until.tv_nsec += LOG_PERIOD * 1000000L;
+        if ( until.tv_nsec >= 1000000000L ) {
+            until.tv_nsec -= 1000000000L;
+            ++until.tv_sec;
+        }
+        pthread_cond_timedwait( &s_wakeup, &s_lock, &until );
+        pthread_mutex_unlock( &s_lock );
+        write_records( );
+        pthread_mutex_lock( &s_lock );
+    }
+    pthread_mutex_unlock( &s_lock );
+    write_records( );
+    return NULL;
+}
+
+extern void init_log( const char *path, log_level level, int sampling )
+{
+    assert( ! atomic_load( &s_started ) );
+    assert( sampling > 0 );
+    if ( NULL == path || 0 == strcmp( path, "-" ) ) {
+        s_file = stdout;
+    } else {
+        s_file = fopen( path, "a" );
+        if ( NULL == s_file ) {
+            printf( "server: could not open log file %s - exiting\n", path );
+            exit(1);
+        }
+    }
+    s_level = level;
+    s_sampling = (unsigned int)sampling;
+    s_stop = false;
+    s_reported = 0;
+    atomic_init( &s_written, 0 );
+    atomic_init( &s_rings, NULL );
+    if ( 0 != pthread_key_create( &s_key, release_ring ) ||
+         0 != pthread_create( &s_thread, NULL, log_thread, NULL ) ) {
+        printf( "server: could not start the log thread - exiting\n" );
+        exit(1);
+    }
+    atomic_store_explicit( &s_started, true, memory_order_release );
+}
+
+extern void get_log_stats( log_stats *stats )
+{
+    stats->written = atomic_load( &s_written );
+    stats->dropped = s_discarded;
+    for ( log_ring *r = atomic_load( &s_rings ); NULL != r; r = r->next ) {
+        stats->dropped += atomic_load_explicit( &r->dropped, memory_order_relaxed );
+    }
+}
+
+extern void discard_log( void )
+{
+    if ( ! atomic_load( &s_started ) ) {
+        return;
+    }
+    atomic_store( &s_started, false );
+    pthread_mutex_lock( &s_lock );
+    s_stop = true;
+    pthread_cond_signal( &s_wakeup );
+    pthread_mutex_unlock( &s_lock );
+    pthread_join( s_thread, NULL );
+
+    pthread_key_delete( s_key );
+    log_ring *r = atomic_exchange( &s_rings, NULL );
+    while ( NULL != r ) {
+        log_ring *next = r->next;
+        s_discarded += atomic_load( &r->dropped );
+        free( r );
+        r = next;
+    }
+    t_ring = NULL;
+    atomic_store( &s_n_rings, 0 );
+    if ( stdout != s_file ) {
+        fclose( s_file );
+    }
+    s_file = NULL;
+}
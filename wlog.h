@@ -0,0 +1,60 @@
+
+#ifndef __WLOG_H__
+#define __WLOG_H__
+
+#include <stdbool.h>
+#include <stdint.h>
+
+// The log writes messages to a file without ever blocking the threads that
+// log them: each thread formats its messages in fixed size records, which
+// are added to a ring buffer owned by the thread, and a background thread
+// copies the records from all ring buffers to the file every LOG_PERIOD ms.
+// If the ring buffer of a thread is full, the message is dropped and counted.
+// Messages longer than LOG_MESSAGE_SIZE - 1 characters are truncated. Each
+// line in the file gives the time, level and thread of the message.
+
+#define LOG_MESSAGE_SIZE    240     // including the terminating 0
+#define LOG_RING_SIZE       1024    // records per thread, must be a power of 2
+#define LOG_PERIOD          10      // ms between two copies to the file
+
+typedef enum {
+    LOG_ERROR, LOG_WARNING, LOG_INFO, LOG_DEBUG
+} log_level;
+
+// set level from its name (error, warning, info or debug) and return true,
+// or return false if the name is unknown.
+extern bool get_log_level_from_name( const char *name, log_level *level );
+
+// start logging messages up to the given level in the file at path (which is
+// appended to), or to the standard output if path is NULL or "-". Debug
+// messages are expected for 1 in sampling requests only (see sample_log).
+// Before the log is started, and after it is discarded, messages are printed
+// directly on the standard output.
+extern void init_log( const char *path, log_level level, int sampling );
+
+// return true if messages at the given level are logged, so that arguments
+// expensive to get can be skipped.
+extern bool is_log_enabled( log_level level );
+
+// return true if the calling thread should log debug messages for its next
+// request, that is if debug messages are logged and 1 in sampling calls in
+// the thread.
+extern bool sample_log( void );
+
+// log a message formatted as with printf, if level is logged
+extern void log_message( log_level level, const char *format, ... )
+    __attribute__((format(printf, 2, 3)));
+
+typedef struct {
+    uint64_t written, dropped;      // records
+} log_stats;
+
+// get the number of records written and dropped since the log was started,
+// including after it is discarded.
+extern void get_log_stats( log_stats *stats );
+
+// write all records left, stop the background thread and free all buffers.
+// No other thread may log at the same time.
+extern void discard_log( void );
+
+#endif /* __WLOG_H__ */
@@ -0,0 +1,174 @@
+
+#include <stdio.h>
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdatomic.h>
+#include <assert.h>
+
+#include "wdict.h"
+#include "wpos.h"
+#include "wmatrix.h"
+
+/*
+    Two layouts are possible for the matrix:
+    - a full matrix, as a single block of n_words * n_words bytes, with one row
+      of n_words patterns per guess. It is computed at once by all threads in
+      the pool, row by row with get_patterns_from_columns.
+    - a tiled matrix, for dictionaries too large for a full matrix, made of
+      MATRIX_TILE_SIZE * MATRIX_TILE_SIZE tiles. Only the table of tile
+      pointers is allocated at initialization. A tile is computed the first
+      time one of its patterns is needed. If multiple threads compute the same
+      tile at the same time, only the first one to publish its tile wins and
+      the other ones discard their own copy.
+*/
+
+#define TILE_BYTES  (MATRIX_TILE_SIZE * MATRIX_TILE_SIZE)
+
+static matrix_type          m_type = NO_MATRIX;
+static int                  m_size;         // number of words
+static uint8_t              *m_full;        // m_size * m_size patterns
+static bool                 m_mapped;       // m_full is in dictionary file
+static int                  m_n_tiles;      // number of tiles per row
+static _Atomic(uint8_t *)   *m_tiles;       // m_n_tiles * m_n_tiles tiles
+
+static void compute_rows( void *ctxt, int first, int last, int worker )
+{
+    (void)ctxt;
+    (void)worker;
+
+    const word_columns *answers = get_dictionary_columns();
+    for ( int guess = first; guess < last; ++guess ) {
+        get_patterns_from_columns( answers, get_nth_word_in_dictionary( guess ),
+                                   &m_full[ (size_t)guess * (size_t)m_size ] );
+    }
+}
+
+static uint8_t *compute_tile( int tile_row, int tile_col )
+{
+    uint8_t *tile = malloc( TILE_BYTES );
+    assert( tile );
+
+    int guess = tile_row * MATRIX_TILE_SIZE;
+    for ( int i = 0; i < MATRIX_TILE_SIZE && guess < m_size; ++i, ++guess ) {
+        const char *word = get_nth_word_in_dictionary( guess );
+        int answer = tile_col * MATRIX_TILE_SIZE;
+        for ( int j = 0; j < MATRIX_TILE_SIZE && answer < m_size; ++j, ++answer ) {
+            tile[ i * MATRIX_TILE_SIZE + j ] = get_pattern_from_words(
+                                get_nth_word_in_dictionary( answer ), word );
+        }
+    }
+    return tile;
+}
+
+extern bool get_matrix_type_from_name( const char *name, matrix_type *type )
+{
+    static const char *names[] = { "auto", "full", "tiled", "none" };
+    for ( int i = AUTO_MATRIX; i <= NO_MATRIX; ++i ) {
+        if ( 0 == strcmp( name, names[i] ) ) {
+            *type = (matrix_type)i;
+            return true;
+        }
+    }
+    return false;
+}
+
+extern matrix_type init_feedback_matrix( matrix_type type, thread_pool *tp )
+{
+    discard_feedback_matrix( );
+
+    m_size = get_dictionary_size();
+    const uint8_t *mapped = get_dictionary_matrix();
+    if ( AUTO_MATRIX == type ) {
+        type = ( NULL != mapped || m_size <= MAX_FULL_MATRIX_WORDS ) ?
+                                                FULL_MATRIX : TILED_MATRIX;
+    }
+
+    switch ( type ) {
+    case FULL_MATRIX:
+        if ( NULL != mapped ) {     // read-only, never written through
+            m_full = (uint8_t *)mapped;
+            m_mapped = true;
+            break;
+        }
+        m_full = malloc( (size_t)m_size * (size_t)m_size );
+        if ( NULL == m_full ) {
+            printf( "wordle: not enough memory for a full feedback matrix\n" );
+            return init_feedback_matrix( TILED_MATRIX, tp );
+        }
+        run_in_thread_pool( tp, m_size, 16, compute_rows, NULL );
+        break;
+    case TILED_MATRIX:
+        m_n_tiles = ( m_size + MATRIX_TILE_SIZE - 1 ) / MATRIX_TILE_SIZE;
+        m_tiles = malloc( sizeof( *m_tiles ) * (size_t)m_n_tiles * (size_t)m_n_tiles );
+        assert( m_tiles );
+        for ( int i = 0; i < m_n_tiles * m_n_tiles; ++i ) {
+            atomic_init( &m_tiles[i], NULL );
+        }
+        break;
+    default:
+        type = NO_MATRIX;
+        break;
+    }
+    m_type = type;
+    return type;
+}
+
+extern matrix_type get_feedback_matrix_type( void )
+{
+    return m_type;
+}
+
+extern uint8_t get_feedback( int guess, int answer )
+{
+    assert( guess >= 0 && guess < m_size && answer >= 0 && answer < m_size );
+
+    if ( FULL_MATRIX == m_type ) {
+        return m_full[ (size_t)guess * (size_t)m_size + (size_t)answer ];
+    }
+
+    assert( TILED_MATRIX == m_type );
+    int tile_row = guess / MATRIX_TILE_SIZE, tile_col = answer / MATRIX_TILE_SIZE;
+    _Atomic(uint8_t *) *slot = &m_tiles[ tile_row * m_n_tiles + tile_col ];
+    uint8_t *tile = atomic_load_explicit( slot, memory_order_acquire );
+    if ( NULL == tile ) {
+        uint8_t *expected = NULL;
+        tile = compute_tile( tile_row, tile_col );
+        if ( ! atomic_compare_exchange_strong_explicit( slot, &expected, tile,
+                            memory_order_acq_rel, memory_order_acquire ) ) {
+            free( tile );           // another thread published it first
+            tile = expected;
+        }
+    }
+    return tile[ (guess % MATRIX_TILE_SIZE) * MATRIX_TILE_SIZE +
+                 (answer % MATRIX_TILE_SIZE) ];
+}
+
+extern const uint8_t *get_feedback_row( int guess )
+{
+    if ( FULL_MATRIX != m_type ) {
+        return NULL;
+    }
+    return &m_full[ (size_t)guess * (size_t)m_size ];
+}
+
+extern void discard_feedback_matrix( void )
+{
+    if ( NULL != m_full ) {
+        if ( ! m_mapped ) {
+            free( m_full );
+        }
+        m_full = NULL;
+        m_mapped = false;
+    }
+    if ( NULL != m_tiles ) {
+        for ( int i = 0; i < m_n_tiles * m_n_tiles; ++i ) {
+            free( atomic_load( &m_tiles[i] ) );
+        }
+        free( m_tiles );
+        m_tiles = NULL;
+    }
+    m_n_tiles = 0;
+    m_type = NO_MATRIX;
+}
@@ -0,0 +1,50 @@
+
+#ifndef __WMATRIX_H__
+#define __WMATRIX_H__
+
+#include <stdbool.h>
+#include <stdint.h>
+#include "wordle.h"
+#include "wpool.h"
+
+// The feedback matrix holds the feedback pattern (see wpos.h) obtained for
+// each guess against each possible answer in the dictionary, both given as
+// indexes in dictionary. Once the matrix is available, scoring a guess is a
+// single lookup in the matrix instead of a comparison of the two words.
+
+typedef enum {
+    AUTO_MATRIX,    // FULL_MATRIX up to MAX_FULL_MATRIX_WORDS, else TILED_MATRIX
+    FULL_MATRIX,    // all patterns computed at once, in parallel
+    TILED_MATRIX,   // tiles of patterns computed on first access
+    NO_MATRIX       // no matrix, patterns must be computed for each pair
+} matrix_type;
+
+// convert a matrix type name ("auto", "full", "tiled" or "none") into a
+// matrix_type. Return false if the name is not recognized.
+extern bool get_matrix_type_from_name( const char *name, matrix_type *type );
+
+// initialize the feedback matrix for the currently loaded dictionary, using
+// the given thread pool (or the calling thread only if tp is NULL) to compute
+// a full matrix. It returns the actual type of matrix: AUTO_MATRIX is never
+// returned. The dictionary must be loaded before. If the dictionary was
+// loaded from a compiled file including a matrix, AUTO_MATRIX and FULL_MATRIX
+// use that matrix in place instead of computing it.
+extern matrix_type init_feedback_matrix( matrix_type type, thread_pool *tp );
+
+// return the current type of feedback matrix (NO_MATRIX if not initialized)
+extern matrix_type get_feedback_matrix_type( void );
+
+// return the feedback pattern for the given guess and answer indexes. It can
+// be called concurrently from multiple threads. The matrix must have been
+// initialized before.
+extern uint8_t get_feedback( int guess, int answer );
+
+// return a pointer to the row of patterns for all answers in dictionary order
+// for the given guess index, or NULL if the matrix is not a FULL_MATRIX. The
+// rows of a FULL_MATRIX are contiguous, in dictionary order.
+extern const uint8_t *get_feedback_row( int guess );
+
+// free the feedback matrix.
+extern void discard_feedback_matrix( void );
+
+#endif /* __WMATRIX_H__ */
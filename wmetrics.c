@@ -0,0 +1,386 @@
+
+#include <stdio.h>
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdarg.h>
+#include <stdatomic.h>
+#include <time.h>
+#include <assert.h>
+
+#include "wmetrics.h"
+#include "wcache.h"
+#include "wlog.h"
+
+/*
+    Each thread counts in its own shard, allocated the first time it counts
+    something and added to a list of all shards, which is never shortened
+    until the metrics are discarded, so that the counts of a thread are kept
+    after it exits. Counters are atomic only so that they can be read while
+    they are written: the owner thread adds to a counter with a relaxed load
+    and store, which is as cheap as a plain addition.
+
+    The bucket of a value is the smallest i such that the value is at most
+    2^(i+shift), or the last bucket (+Inf) for larger values.
+*/
+
+#define N_SOLVER_STATUS     ( TOO_MANY_WRONG_POSITION_LETTERS + 1 )
+#define STRATEGY_ERROR      N_SOLVER_STATUS     // after the data errors
+#define N_SOLVER_ERRORS     ( STRATEGY_ERROR + 1 )
+#define LATENCY_SHIFT       8       // first bucket up to 256 ns
+#define N_LATENCY_BUCKETS   24      // last finite bucket up to 2^30 ns
+#define N_CANDIDATE_BUCKETS 16      // last finite bucket up to 16384
+#define METRICS_TEXT_SIZE   (16 * 1024)
+
+typedef struct {
+    atomic_ullong   buckets[N_LATENCY_BUCKETS];
+    atomic_ullong   sum;            // ns
+} latency_histogram;
+
+typedef struct _metrics_shard {
+    struct _metrics_shard   *next;
+    latency_histogram       requests[N_ENDPOINTS];
+    latency_histogram       phases[N_PHASES];
+    atomic_ullong           errors[N_SOLVER_ERRORS];
+    atomic_ullong           candidates[N_CANDIDATE_BUCKETS];
+    atomic_ullong           candidate_sum;
+    atomic_ullong           opened, closed;         // connections
+} metrics_shard;
+
+static const char *s_endpoint_names[N_ENDPOINTS] = {
+    "player", "solver", "play", "solve", "metrics", "unknown"
+};
+
+static const char *s_phase_names[N_PHASES] = {
+    "parse", "set_data", "solutions", "suggestion", "serialization"
+};
+
+static const char *s_status_names[N_SOLVER_ERRORS] = {
+    "set", "non_modulo_10_data_string_length", "data_string_length_too_large",
+    "invalid_code_in_data", "invalid_letter_in_data",
+    "conflicting_exact_position_letters", "exact_position_letter_not_in_word",
+    "wrong_position_letter_in_exact_position",
+    "wrong_position_letter_not_in_word", "too_many_wrong_position_letters",
+    "unknown_strategy"
+};
+
+static _Atomic(metrics_shard *) s_shards;
+static _Thread_local metrics_shard *t_shard;
+
+static metrics_shard *get_shard( void )
+{
+    if ( NULL == t_shard ) {
+        metrics_shard *ms = calloc( 1, sizeof( metrics_shard ) );
+        if ( NULL == ms ) {
+            printf( "server: could not allocate memory for metrics - exiting\n" );
+            exit(1);
+        }
+        ms->next = atomic_load( &s_shards );
+        while ( ! atomic_compare_exchange_weak( &s_shards, &ms->next, ms ) ) {
+        }
+        t_shard = ms;
+    }
+    return t_shard;
+}
+
+// add to a counter written only by the calling thread
+static void add( atomic_ullong *counter, uint64_t value )
+{
+    atomic_store_explicit( counter, value +
+        atomic_load_explicit( counter, memory_order_relaxed ),
+        memory_order_relaxed );
+}
+
+static int get_bucket( uint64_t value, int shift, int n_buckets )
+{
+    int i = ( value <= 1 ) ? 0 : 64 - __builtin_clzll( value - 1 ) - shift;
+    if ( i < 0 ) {
+        i = 0;
+    } else if ( i >= n_buckets ) {
+        i = n_buckets - 1;
+    }
+    return i;
+}
+
+static void add_latency( latency_histogram *lh, uint64_t ns )
+{
+    add( &lh->buckets[ get_bucket( ns, LATENCY_SHIFT, N_LATENCY_BUCKETS ) ], 1 );
+    add( &lh->sum, ns );
+}
+
+extern uint64_t get_metrics_time( void )
+{
+    struct timespec now;
+    clock_gettime( CLOCK_MONOTONIC, &now );
+    return (uint64_t)now.tv_sec * 1000000000ull + (uint64_t)now.tv_nsec;
+}
+
+extern uint64_t add_request_metric( server_endpoint endpoint, uint64_t start )
+{
+    assert( endpoint < N_ENDPOINTS );
+    uint64_t elapsed = get_metrics_time( ) - start;
+    add_latency( &get_shard( )->requests[endpoint], elapsed );
+    return elapsed;
+}
+
+extern uint64_t add_phase_metric( request_phase phase, uint64_t start )
+{
+    assert( phase < N_PHASES );
+    uint64_t now = get_metrics_time( );
+    add_latency( &get_shard( )->phases[phase], now - start );
+    return now;
+}
+
+extern void add_error_metric( solver_data_status status )
+{
+    assert( status < N_SOLVER_STATUS );
+    add( &get_shard( )->errors[status], 1 );
+}
+
+extern void add_strategy_error_metric( void )
+{
+    add( &get_shard( )->errors[STRATEGY_ERROR], 1 );
+}
+
+extern void add_candidates_metric( int n_candidates )
+{
+    metrics_shard *ms = get_shard( );
+    add( &ms->candidates[ get_bucket( (uint64_t)n_candidates, 0,
+                                      N_CANDIDATE_BUCKETS ) ], 1 );
+    add( &ms->candidate_sum, (uint64_t)n_candidates );
+}
+
+extern void add_connection_metric( bool opened )
+{
+    metrics_shard *ms = get_shard( );
+    add( opened ? &ms->opened : &ms->closed, 1 );
+}
+
+typedef struct {
+    arena   *a;
+    char    *buffer;
+    size_t  size, used;
+} metrics_text;
+
+// append to the text, which is moved to a larger buffer if needed
+static void append( metrics_text *mt, const char *format, ... )
+    __attribute__((format(printf, 2, 3)));
+
+static void append( metrics_text *mt, const char *format, ... )
+{
+    while ( true ) {
+        va_list args;
+        va_start( args, format );
+        size_t n = (size_t)vsnprintf( &mt->buffer[mt->used], mt->size - mt->used,
+                                      format, args );
+        va_end( args );
+        if ( mt->used + n < mt->size ) {
+            mt->used += n;
+            return;
+        }
+        char *buffer = arena_alloc( mt->a, 2 * mt->size );
+        memcpy( buffer, mt->buffer, mt->used );
+        mt->buffer = buffer;
+        mt->size *= 2;
+    }
+}
+
+static void append_header( metrics_text *mt, const char *name,
+                           const char *type, const char *help )
+{
+    append( mt, "# HELP %s %s\n# TYPE %s %s\n", name, help, name, type );
+}
+
+// append the cumulative buckets of a histogram, with the upper bound of the
+// first bucket given in the unit of the metric.
+static void append_histogram( metrics_text *mt, const char *name,
+                              const char *label, const char *value,
+                              const uint64_t *buckets, int n_buckets,
+                              double first, double sum )
+{
+    char labels[64] = "";
+    if ( NULL != label ) {
+        snprintf( labels, sizeof(labels), "%s=\"%s\",", label, value );
+    }
+    uint64_t count = 0;
+    double bound = first;
+    for ( int i = 0; i < n_buckets - 1; ++i, bound *= 2 ) {
+        count += buckets[i];
+        append( mt, "%s_bucket{%sle=\"%.10g\"} %llu\n", name, labels, bound,
+                (unsigned long long)count );
+    }
+    count += buckets[n_buckets-1];
+    append( mt, "%s_bucket{%sle=\"+Inf\"} %llu\n", name, labels,
+            (unsigned long long)count );
+    if ( NULL != label ) {
+        snprintf( labels, sizeof(labels), "{%s=\"%s\"}", label, value );
+    }
+    append( mt, "%s_sum%s %.9g\n%s_count%s %llu\n", name, labels, sum,
+            name, labels, (unsigned long long)count );
+}
+
+// sum of all threads counts
+typedef struct {
+    uint64_t    buckets[N_LATENCY_BUCKETS];
+    uint64_t    sum;
+} latency_totals;
+
+typedef struct {
+    latency_totals  requests[N_ENDPOINTS];
+    latency_totals  phases[N_PHASES];
+    uint64_t        errors[N_SOLVER_ERRORS];
+    uint64_t        candidates[N_CANDIDATE_BUCKETS];
+    uint64_t        candidate_sum;
+    uint64_t        opened, closed;
+} metrics_totals;
+
+static uint64_t get( atomic_ullong *counter )
+{
+    return atomic_load_explicit( counter, memory_order_relaxed );
+}
+
+static void add_latency_totals( latency_totals *lt, latency_histogram *lh )
+{
+    for ( int i = 0; i < N_LATENCY_BUCKETS; ++i ) {
+        lt->buckets[i] += get( &lh->buckets[i] );
+    }
+    lt->sum += get( &lh->sum );
+}
+
+static void get_metrics_totals( metrics_totals *mt )
+{
+    memset( mt, 0, sizeof( metrics_totals ) );
+    for ( metrics_shard *ms = atomic_load( &s_shards ); NULL != ms; ms = ms->next ) {
+        for ( int e = 0; e < N_ENDPOINTS; ++e ) {
+            add_latency_totals( &mt->requests[e], &ms->requests[e] );
+        }
+        for ( int p = 0; p < N_PHASES; ++p ) {
+            add_latency_totals( &mt->phases[p], &ms->phases[p] );
+        }
+        for ( int s = 0; s < N_SOLVER_ERRORS; ++s ) {
+            mt->errors[s] += get( &ms->errors[s] );
+        }
+        for ( int i = 0; i < N_CANDIDATE_BUCKETS; ++i ) {
+            mt->candidates[i] += get( &ms->candidates[i] );
+        }
+        mt->candidate_sum += get( &ms->candidate_sum );
+        mt->opened += get( &ms->opened );
+        mt->closed += get( &ms->closed );
+    }
+}
+
+static uint64_t get_count( const latency_totals *lt )
+{
+    uint64_t count = 0;
+    for ( int i = 0; i < N_LATENCY_BUCKETS; ++i ) {
+        count += lt->buckets[i];
+    }
+    return count;
+}
+
+extern char *get_metrics_text( arena *a )
+{
+    metrics_totals totals;
+    get_metrics_totals( &totals );
+
+    metrics_text mt;
+    mt.a = a;
+    mt.size = METRICS_TEXT_SIZE;
+    mt.buffer = arena_alloc( a, mt.size );
+    mt.used = 0;
+    mt.buffer[0] = 0;
+
+    const double first = (double)( 1 << LATENCY_SHIFT ) * 1e-9;
+    append_header( &mt, "wordle_requests_total", "counter",
+                   "Requests answered, by endpoint." );
+    for ( int e = 0; e < N_ENDPOINTS; ++e ) {
+        append( &mt, "wordle_requests_total{endpoint=\"%s\"} %llu\n",
+                s_endpoint_names[e],
+                (unsigned long long)get_count( &totals.requests[e] ) );
+    }
+    append_header( &mt, "wordle_request_duration_seconds", "histogram",
+                   "Time taken to answer a request, by endpoint." );
+    for ( int e = 0; e < N_ENDPOINTS; ++e ) {
+        append_histogram( &mt, "wordle_request_duration_seconds", "endpoint",
+                          s_endpoint_names[e], totals.requests[e].buckets,
+                          N_LATENCY_BUCKETS, first,
+                          (double)totals.requests[e].sum * 1e-9 );
+    }
+    append_header( &mt, "wordle_solve_phase_duration_seconds", "histogram",
+                   "Time taken by each phase of a solver request, for the phases it went through (cached responses only parse and set data)." );
+    for ( int p = 0; p < N_PHASES; ++p ) {
+        append_histogram( &mt, "wordle_solve_phase_duration_seconds", "phase",
+                          s_phase_names[p], totals.phases[p].buckets,
+                          N_LATENCY_BUCKETS, first,
+                          (double)totals.phases[p].sum * 1e-9 );
+    }
+    append_header( &mt, "wordle_solve_errors_total", "counter",
+                   "Solver requests with invalid data or strategy, by status." );
+    for ( int s = SOLVER_DATA_SET + 1; s < N_SOLVER_ERRORS; ++s ) {
+        append( &mt, "wordle_solve_errors_total{status=\"%s\"} %llu\n",
+                s_status_names[s], (unsigned long long)totals.errors[s] );
+    }
+    append_header( &mt, "wordle_solve_candidates", "histogram",
+                   "Candidates left after a solver request." );
+    append_histogram( &mt, "wordle_solve_candidates", NULL, NULL,
+                      totals.candidates, N_CANDIDATE_BUCKETS, 1.0,
+                      (double)totals.candidate_sum );
+
+    solver_cache_stats cs;
+    get_solver_cache_stats( &cs );
+    append_header( &mt, "wordle_cache_hits_total", "counter", "Solver cache hits." );
+    append( &mt, "wordle_cache_hits_total %llu\n", (unsigned long long)cs.hits );
+    append_header( &mt, "wordle_cache_misses_total", "counter", "Solver cache misses." );
+    append( &mt, "wordle_cache_misses_total %llu\n", (unsigned long long)cs.misses );
+    append_header( &mt, "wordle_cache_insertions_total", "counter",
+                   "Responses added to the solver cache." );
+    append( &mt, "wordle_cache_insertions_total %llu\n",
+            (unsigned long long)cs.insertions );
+    append_header( &mt, "wordle_cache_evictions_total", "counter",
+                   "Responses evicted from the solver cache." );
+    append( &mt, "wordle_cache_evictions_total %llu\n",
+            (unsigned long long)cs.evictions );
+    append_header( &mt, "wordle_cache_hit_ratio", "gauge",
+                   "Solver cache hits per lookup since start." );
+    append( &mt, "wordle_cache_hit_ratio %.6f\n", ( 0 == cs.hits + cs.misses ) ?
+            0.0 : (double)cs.hits / (double)( cs.hits + cs.misses ) );
+    append_header( &mt, "wordle_cache_entries", "gauge",
+                   "Responses in the solver cache." );
+    append( &mt, "wordle_cache_entries %d\n", cs.n_entries );
+    append_header( &mt, "wordle_cache_capacity", "gauge",
+                   "Maximum number of responses in the solver cache." );
+    append( &mt, "wordle_cache_capacity %d\n", cs.capacity );
+
+    append_header( &mt, "wordle_connections_total", "counter",
+                   "Connections opened." );
+    append( &mt, "wordle_connections_total %llu\n",
+            (unsigned long long)totals.opened );
+    append_header( &mt, "wordle_active_connections", "gauge",
+                   "Connections currently open." );
+    append( &mt, "wordle_active_connections %lld\n",
+            (long long)( totals.opened - totals.closed ) );
+
+    log_stats ls;
+    get_log_stats( &ls );
+    append_header( &mt, "wordle_log_messages_total", "counter",
+                   "Log messages written." );
+    append( &mt, "wordle_log_messages_total %llu\n",
+            (unsigned long long)ls.written );
+    append_header( &mt, "wordle_log_dropped_total", "counter",
+                   "Log messages dropped because a thread buffer was full." );
+    append( &mt, "wordle_log_dropped_total %llu\n",
+            (unsigned long long)ls.dropped );
+    return mt.buffer;
+}
+
+extern void discard_metrics( void )
+{
+    metrics_shard *ms = atomic_exchange( &s_shards, NULL );
+    while ( NULL != ms ) {
+        metrics_shard *next = ms->next;
+        free( ms );
+        ms = next;
+    }
+    t_shard = NULL;
+}
@@ -0,0 +1,70 @@
+
+#ifndef __WMETRICS_H__
+#define __WMETRICS_H__
+
+#include <stdbool.h>
+#include <stdint.h>
+#include "warena.h"
+#include "wsolve.h"
+
+// Server metrics are counted by each thread in its own counters, which are
+// only written by that thread, so that counting does not need any lock or
+// atomic read-modify-write operation. The counters of all threads are summed
+// when the metrics are read, which may happen at any time in any thread.
+// Durations are counted in histograms with power of 2 buckets, from 256 ns
+// to about 1 s, and the candidates left after a solver request in power of 2
+// buckets from 1 to 16384.
+
+typedef enum {
+    PLAYER_PAGE_ENDPOINT, SOLVER_PAGE_ENDPOINT, PLAY_ENDPOINT, SOLVE_ENDPOINT,
+    METRICS_ENDPOINT, UNKNOWN_ENDPOINT, N_ENDPOINTS
+} server_endpoint;
+
+// phases of a solver request. A response found in the solver cache (see
+// wcache.h) only counts the first two phases, and a response found in the
+// opening book (see wbook.h) does not count the solutions and suggestion
+// phases.
+typedef enum {
+    PARSE_PHASE,            // getting the request parameters
+    SET_DATA_PHASE,         // set_solver_data
+    SOLUTIONS_PHASE,        // getting the solutions
+    SUGGESTION_PHASE,       // getting the suggestions
+    SERIALIZATION_PHASE,    // building the response
+    N_PHASES
+} request_phase;
+
+// return the current monotonic time in ns, used to measure durations
+extern uint64_t get_metrics_time( void );
+
+// count a request to endpoint, answered in the time elapsed since start, and
+// return that time in ns.
+extern uint64_t add_request_metric( server_endpoint endpoint, uint64_t start );
+
+// count a phase of a solver request that started at start, and return the
+// current time, at which the next phase starts.
+extern uint64_t add_phase_metric( request_phase phase, uint64_t start );
+
+// count a solver request with invalid data
+extern void add_error_metric( solver_data_status status );
+
+// count a solver request with an unknown strategy, with the invalid data
+// (as status unknown_strategy)
+extern void add_strategy_error_metric( void );
+
+// count the number of candidates left after a solver request, including
+// requests answered from the solver cache or the opening book
+extern void add_candidates_metric( int n_candidates );
+
+// count a connection opened (or closed if opened is false)
+extern void add_connection_metric( bool opened );
+
+// return all metrics in the Prometheus text format, allocated in the given
+// arena, including the solver cache (see wcache.h) and log (see wlog.h)
+// statistics.
+extern char *get_metrics_text( arena *a );
+
+// free the counters of all threads. No other thread may count metrics at the
+// same time.
+extern void discard_metrics( void );
+
+#endif /* __WMETRICS_H__ */
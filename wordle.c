@@ -12,6 +12,11 @@
 #include "wstats.h"
 #include "wpos.h"
 #include "wsolve.h"
+#include "wmatrix.h"
+#include "wsuggest.h"
+#include "wtree.h"
+#include "wbook.h"
+#include "wsim.h"
 
 #define NOT_IN     '-'
 #define IN_WRONG   'w'
@@ -103,14 +108,24 @@ static void play( void )
 
 static void help( void )
 {
-    printf( "wordle -h -f -d=<sets>\n" );
+    printf( "wordle -h -f[=<width>,<depth>] -d=<sets> -k=<n> -s=<strategy> -t=<tree> -m=<matrix> -w=<path>\n" );
+    printf( "wordle --compile-dict <text path> <compiled path> [--with-matrix]\n" );
+    printf( "wordle --word-sets <size> <count> -w=<path>\n" );
+    printf( "wordle --build-tree <tree path> -m=<matrix> -w=<path>\n" );
+    printf( "wordle --simulate <strategy>[,<strategy>...] [--start <word>] -m=<matrix> -w=<path>\n" );
+    printf( "wordle --build-book <book path> <word>[,<word>...] [--deep] -m=<matrix> -w=<path>\n" );
     printf( "    Wordle prints a list of letter statistics in words or a list of\n" );
     printf( "    possible words, given the constraints expressed by option -d,\n" );
     printf( "    or starts a random wordle game if no argument is given.\n\n" );
     printf( "Options:\n" );
     printf( "    -h  print this help message and exits.\n" );
-    printf( "    -f  print frequencies of letter appearance at all positions\n" );
-    printf( "        and exits\n" );
+    printf( "    -f  print frequencies of letter appearance at all positions,\n" );
+    printf( "        of bigrams, trigrams and letter pairs at given positions,\n" );
+    printf( "        and the best sequences of starting words without common\n" );
+    printf( "        letters, then exits. Optionally, the search selects width\n" );
+    printf( "        words (at most %d) at each step, for sequences of depth\n", MAX_SEARCH_WIDTH );
+    printf( "        words (at most %d). The default is -f=%d,%d.\n\n", MAX_SEARCH_DEPTH,
+            SEARCH_WIDTH, SEARCH_DEPTH );
     printf( "    -d  print the list of words that match the given constraints\n" );
     printf( "        and exits. The constraints are expressed as a string made\n" );
     printf( "        of a series of sets, each set describing the results of an\n" );
@@ -120,6 +135,35 @@ static void help( void )
     printf( "        one is a code indicating whether the following letter is at\n" );
     printf( "        the right position (r), a wrong position (w) or not in the\n" );
     printf( "        word(n), and the second one is the letter in question.\n\n" );
+    printf( "    -k  with -d, print the n best words to try (at most %d) with\n", MAX_SUGGESTIONS );
+    printf( "        their entropy, the expected number of words left and the\n" );
+    printf( "        number of words left in the worst case.\n\n" );
+    printf( "    -s  with -d, select how words to try are compared: entropy\n" );
+    printf( "        (the default, most information on average), minimax\n" );
+    printf( "        (fewest words left in the worst case), expected (fewest\n" );
+    printf( "        words left on average) or positional (most frequent\n" );
+    printf( "        letters at each position, the fastest).\n\n" );
+    printf( "    -t  with -d, also print the word to try according to the\n" );
+    printf( "        given decision tree, built with --build-tree.\n\n" );
+    printf( "    -m  select the type of feedback matrix used to score words:\n" );
+    printf( "        auto (full or tiled depending on the dictionary size),\n" );
+    printf( "        full (computed at once), tiled (computed on demand) or\n" );
+    printf( "        none (words are compared for each score). The default\n" );
+    printf( "        depends on the mode: auto with --build-tree, --build-book\n" );
+    printf( "        and --simulate, none otherwise.\n\n" );
+    printf( "    --word-sets print the count sets of size words (at most %d)\n", MAX_SEARCH_DEPTH );
+    printf( "        without common letters that have the most frequent letters\n" );
+    printf( "        at each position, among all such sets in the dictionary.\n\n" );
+    printf( "    --build-tree search the decision tree that finds all words with\n" );
+    printf( "        the fewest tries on average, and write it in the given file.\n" );
+    printf( "        An interrupted search resumes from <tree path>.checkpoint.\n\n" );
+    printf( "    --build-book write the opening book for the given opening words,\n" );
+    printf( "        to be used by the server. With --deep, the book also holds\n" );
+    printf( "        the answers to the second row, if the suggested word is tried.\n\n" );
+    printf( "    --simulate play a game for each word in the dictionary with each\n" );
+    printf( "        given strategy (see -s), and print the number of tries\n" );
+    printf( "        needed and the time per game. With --start, all games start\n" );
+    printf( "        with the given word instead of the suggested one.\n\n" );
     printf( "Options -d and -f are exclusive.\n\n");
     printf( "Examples:\n" );
     printf( "    wordle -d=rsnlwawtne\n" );
@@ -142,15 +186,49 @@ static void help( void )
 }
 
 typedef struct {
-    char *data;
-    bool frequencies;
+    char        *data;
+    int         k;
+    suggest_strategy strategy;
+    bool        frequencies;
+    int         width;          // starting word search
+    int         depth;
+    matrix_type matrix;
+    char        *dictionary;
+    char        *compiled;      // compiled dictionary to create
+    bool        with_matrix;
+    char        *tree;          // decision tree to build or to use
+    bool        build_tree;
+    char        *book;          // opening book to build
+    char        *openings;      // opening words in book
+    bool        deep;           // book includes the second row
+    int         set_size;       // words in sets, 0 if no word sets
+    int         n_sets;         // word sets printed
+    char        *simulate;      // strategies to simulate
+    char        *start;         // first word in simulated games
 } args_t;
 
 static void get_args( int argc, char **argv, args_t *args )
 {
     assert( NULL != args );
     args->data = NULL;
+    args->k = 1;
+    args->strategy = ENTROPY_STRATEGY;
     args->frequencies = false;
+    args->width = SEARCH_WIDTH;
+    args->depth = SEARCH_DEPTH;
+    args->matrix = NO_MATRIX;
+    args->dictionary = WORDLE_DICTIONARY;
+    args->compiled = NULL;
+    args->with_matrix = false;
+    args->tree = NULL;
+    args->build_tree = false;
+    args->book = NULL;
+    args->openings = NULL;
+    args->deep = false;
+    args->set_size = 0;
+    args->n_sets = 0;
+    args->simulate = NULL;
+    args->start = NULL;
 
     char **pp = &argv[1];
     while (--argc) {
@@ -160,9 +238,21 @@ static void get_args( int argc, char **argv, args_t *args )
             case 'h': case 'H':
                 help();
                 exit(0);
-            case 'f': case 'F':
+            case 'f': case 'F': {
+                int end = 0;    // nothing may follow the depth
                 args->frequencies = true;
+                if ( ( 0 != *s && '=' != *s ) ||
+                     ( '=' == *s &&
+                       ( 2 != sscanf( s + 1, "%d,%d%n", &args->width, &args->depth, &end ) ||
+                         0 != s[1+end] ||
+                         args->width < 1 || args->width > MAX_SEARCH_WIDTH ||
+                         args->depth < 1 || args->depth > MAX_SEARCH_DEPTH ) ) ) {
+                    printf("wordle: option -f may be followed by '=<width>,<depth>', with width in [1-%d] and depth in [1-%d]\n",
+                           MAX_SEARCH_WIDTH, MAX_SEARCH_DEPTH );
+                    exit(1);
+                }
                 break;
+            }
             case 'd': case 'D':
                 if (*s++ == '=') {
                     if ( NULL != args->data ) {
@@ -175,6 +265,85 @@ static void get_args( int argc, char **argv, args_t *args )
                     exit(1);
                 }
                 break;
+            case 'm': case 'M':
+                if ( *s++ != '=' || ! get_matrix_type_from_name( s, &args->matrix ) ) {
+                    printf("wordle: option -m must be followed by '=auto', '=full', '=tiled' or '=none'\n");
+                    exit(1);
+                }
+                break;
+            case 'k': case 'K':
+                if ( *s++ != '=' || 1 != sscanf( s, "%d", &args->k ) ||
+                     args->k < 1 || args->k > MAX_SUGGESTIONS ) {
+                    printf("wordle: option -k must be followed by '=<n>', with n in [1-%d]\n",
+                           MAX_SUGGESTIONS );
+                    exit(1);
+                }
+                break;
+            case 's': case 'S':
+                if ( *s++ != '=' || ! get_strategy_from_name( s, &args->strategy ) ) {
+                    printf("wordle: option -s must be followed by '=entropy', '=minimax', '=expected' or '=positional'\n");
+                    exit(1);
+                }
+                break;
+            case 't': case 'T':
+                if ( *s++ != '=' || 0 == *s ) {
+                    printf("wordle: option -t must be followed by '=<path>'\n");
+                    exit(1);
+                }
+                args->tree = s;
+                break;
+            case 'w': case 'W':
+                if ( *s++ != '=' || 0 == *s ) {
+                    printf("wordle: option -w must be followed by '=<path>'\n");
+                    exit(1);
+                }
+                args->dictionary = s;
+                break;
+            case '-':
+                if ( 0 == strcmp( s, "compile-dict" ) && argc > 2 ) {
+                    args->dictionary = pp[1];
+                    args->compiled = pp[2];
+                    pp += 2;
+                    argc -= 2;
+                } else if ( 0 == strcmp( s, "with-matrix" ) ) {
+                    args->with_matrix = true;
+                } else if ( 0 == strcmp( s, "build-tree" ) && argc > 1 ) {
+                    args->tree = pp[1];
+                    args->build_tree = true;
+                    ++pp;
+                    --argc;
+                } else if ( 0 == strcmp( s, "build-book" ) && argc > 2 ) {
+                    args->book = pp[1];
+                    args->openings = pp[2];
+                    pp += 2;
+                    argc -= 2;
+                } else if ( 0 == strcmp( s, "word-sets" ) && argc > 2 ) {
+                    if ( 1 != sscanf( pp[1], "%d", &args->set_size ) ||
+                         1 != sscanf( pp[2], "%d", &args->n_sets ) ||
+                         args->set_size < 1 || args->set_size > MAX_SEARCH_DEPTH ||
+                         args->n_sets < 1 || args->n_sets > MAX_WORD_SETS ) {
+                        printf("wordle: option --word-sets must be followed by <size> <count>, with size in [1-%d] and count in [1-%d]\n",
+                               MAX_SEARCH_DEPTH, MAX_WORD_SETS );
+                        exit(1);
+                    }
+                    pp += 2;
+                    argc -= 2;
+                } else if ( 0 == strcmp( s, "simulate" ) && argc > 1 ) {
+                    args->simulate = pp[1];
+                    ++pp;
+                    --argc;
+                } else if ( 0 == strcmp( s, "start" ) && argc > 1 ) {
+                    args->start = pp[1];
+                    ++pp;
+                    --argc;
+                } else if ( 0 == strcmp( s, "deep" ) ) {
+                    args->deep = true;
+                } else {
+                    printf("wordle: error option --%s not recognized or incomplete\n", s);
+                    help();
+                    exit(1);
+                }
+                break;
 
             default:
                 printf("wordle: error option -%c not recognized\n", *(s-1));
@@ -190,15 +359,74 @@ static void get_args( int argc, char **argv, args_t *args )
     }
 }
 
+// exit if any name in the comma separated list of strategies is unknown or
+// empty, so that no simulation is started with an invalid list.
+static void check_strategy_list( const char *names )
+{
+    for ( const char *s = names; ; ) {
+        const char *end = strchr( s, ',' );
+        size_t len = ( NULL == end ) ? strlen( s ) : (size_t)( end - s );
+        char name[16] = "";     // left empty if too long for any strategy
+        if ( len < sizeof( name ) ) {
+            memcpy( name, s, len );
+            name[len] = 0;
+        }
+        suggest_strategy strategy;
+        if ( ! get_strategy_from_name( name, &strategy ) ) {
+            printf( "wordle: unknown strategy '%.*s'\n", (int)len, s );
+            exit(1);
+        }
+        if ( NULL == end ) {
+            break;
+        }
+        s = end + 1;
+    }
+}
+
 enum operations {
- STATS, PLAY, SOLVE
+ STATS, WORD_SETS, PLAY, SOLVE, COMPILE, BUILD_TREE, BUILD_BOOK, SIMULATE
 };
 
 static enum operations process_args( args_t *args, solver_data *given )
 {
+    if ( NULL != args->compiled ) {
+        return COMPILE;
+    }
+    if ( args->with_matrix ) {
+        printf("wordle: option --with-matrix requires --compile-dict\n");
+        exit(1);
+    }
+    if ( args->deep && NULL == args->book ) {
+        printf("wordle: option --deep requires --build-book\n");
+        exit(1);
+    }
+    if ( NULL != args->start ) {
+        if ( NULL == args->simulate ) {
+            printf("wordle: option --start requires --simulate\n");
+            exit(1);
+        }
+        if ( WORD_SIZE != strnlen( args->start, WORD_SIZE+1 ) ||
+             ! is_word_in_dictionary( args->start ) ) {
+            printf("wordle: starting word %s is not in dictionary\n", args->start );
+            exit(1);
+        }
+    }
+    if ( args->build_tree || NULL != args->book || NULL != args->simulate ) {
+        if ( NO_MATRIX == args->matrix ) {
+            args->matrix = AUTO_MATRIX;
+        }
+        if ( NULL != args->simulate ) {
+            check_strategy_list( args->simulate );
+            return SIMULATE;
+        }
+        return args->build_tree ? BUILD_TREE : BUILD_BOOK;
+    }
     if ( args->frequencies ) {
         return STATS;
     }
+    if ( 0 != args->set_size ) {
+        return WORD_SETS;
+    }
 
     if ( NULL == args->data ) {
         return PLAY;
@@ -216,38 +444,106 @@ int main ( int argc, char **argv )
     args_t args;
     get_args( argc, argv, &args );
 
-    load_dictionary( WORDLE_DICTIONARY );
+    load_dictionary( args.dictionary );
 
     solver_data given;
     enum operations op = process_args( &args, &given );
 
-    word_node *result;
+    thread_pool *pool = NULL;
+    if ( args.with_matrix ) {
+        args.matrix = FULL_MATRIX;
+    }
+    if ( NO_MATRIX != args.matrix || SOLVE == op || STATS == op ||
+         WORD_SETS == op ) {
+        pool = create_thread_pool( 0 );
+    }
+    if ( NO_MATRIX != args.matrix ) {
+        init_feedback_matrix( args.matrix, pool );
+    }
+    init_suggestions( pool, 0 );   // no time limit
+
+    arena a;
+    word_span result;
     switch ( op ) {
     case STATS:
-        print_letter_stats( );
+        print_letter_stats( pool, args.width, args.depth );
+        break;
+    case WORD_SETS:
+        print_word_sets( pool, args.set_size, args.n_sets );
         break;
     case SOLVE:
 //        print_solver_data( &given );
-        result = get_solutions( &given );
-        if ( NULL == result ) {
+        init_arena( &a, sizeof(int) * ( get_dictionary_size() + 64 ) );
+        get_solution_span( &given, &a, &result );
+        if ( 0 == result.n_words ) {
             printf( "No solution\n" );
         } else {
-            const char *best = select_most_likely_word( result );
+            suggestion best[MAX_SUGGESTIONS];
+            int n_best = get_suggestions( &result, args.strategy, args.k, &a, best );
             printf("Possiblities:\n");
-            for ( word_node *wn = result ; wn; wn = wn->next ) {
-                printf(" %s\n", wn->word );
+            for ( int i = 0; i < result.n_words; ++i ) {
+                printf(" %s\n", get_nth_word_in_dictionary( result.indexes[i] ) );
+            }
+            if ( 0 != n_best ) {
+                printf( "Suggesting to try %s\n", best[0].word );
+            }
+            if ( NULL != args.tree ) {
+                load_decision_tree( args.tree );
+                const char *word = get_decision_tree_word( args.data );
+                if ( NULL != word ) {
+                    printf( "Decision tree suggests %s\n", word );
+                } else {
+                    printf( "Decision tree has no suggestion\n" );
+                }
+                discard_decision_tree( );
             }
-            if ( NULL != best ) {
-                printf( "Suggesting to try %s\n", best );
+            if ( args.k > 1 && 0 != n_best ) {
+                printf( "Best words to try:        entropy  expected  worst\n" );
+                for ( int i = 0; i < n_best; ++i ) {
+                    printf( " %2d %s %20.3f %9.3f %6d\n", i + 1, best[i].word,
+                            best[i].entropy, best[i].expected, best[i].worst );
+                }
             }
-            free_word_list( result );
         }
+        discard_arena( &a );
         discard_solver_data( &given );
         break;
      case PLAY:
         play( );
         break;
+    case COMPILE:
+        if ( args.with_matrix && FULL_MATRIX != get_feedback_matrix_type() ) {
+            printf( "wordle: not enough memory to include the matrix\n" );
+            exit(1);
+        }
+        save_dictionary( args.compiled,
+                         args.with_matrix ? get_feedback_row( 0 ) : NULL );
+        printf( "Compiled %d words into %s\n", get_dictionary_size(), args.compiled );
+        break;
+    case BUILD_TREE:
+        {
+            char checkpoint[FILENAME_MAX];
+            snprintf( checkpoint, FILENAME_MAX, "%s.checkpoint", args.tree );
+            build_decision_tree( args.tree, checkpoint, pool );
+        }
+        break;
+    case BUILD_BOOK:
+        build_opening_book( args.book, args.openings, args.deep );
+        break;
+    case SIMULATE:
+        for ( char *name = strtok( args.simulate, "," ); NULL != name;
+              name = strtok( NULL, "," ) ) {
+            suggest_strategy strategy;
+            if ( ! get_strategy_from_name( name, &strategy ) ) {
+                printf( "wordle: unknown strategy %s\n", name );
+                exit(1);
+            }
+            simulate_games( pool, strategy, args.start );
+        }
+        break;
     }
+    discard_feedback_matrix( );
+    discard_thread_pool( pool );
     discard_dictionary( );
     return 0;
 }
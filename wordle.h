@@ -14,7 +14,33 @@ typedef struct _word_node {
 #define ALPHABET_SIZE           26
 
 #define MAX_WORD_NUMBER         10000
-#define MAX_WORD_HASH_ENTRIES   65521   // only about 3% collisions
+
+// feedback patterns (see wpos.h)
+#define N_PATTERNS              243     // 3 ^ WORD_SIZE
+#define WINNING_PATTERN         (N_PATTERNS-1)
+
+// solver: maximum number of operations on the dictionary index before
+// switching to a scan of the dictionary columns (see wsolve.c). With AVX2,
+// an index operation costs about 1/40 of a full scan.
+#define MAX_INDEX_OPERATIONS    40
+
+// feedback matrix (see wmatrix.h)
+#define MAX_FULL_MATRIX_WORDS   4096    // up to 16 MB in a single block
+#define MATRIX_TILE_SIZE        64      // 4 KB tiles for larger dictionaries
+
+// suggestions (see wsuggest.h)
+#define SUGGESTION_BUDGET       50      // ms, for the server only
+#define MAX_SUGGESTIONS         20      // k best words returned at most
+
+// server solver sessions (see wsession.h)
+#define SESSION_TTL             600     // seconds
+#define MAX_SESSION_MEMORY      16      // MB
+
+// server solver cache (see wcache.h)
+#define SOLVER_CACHE_SIZE       1024    // entries
+
+// decision tree search (see wtree.h)
+#define MAX_TREE_MEMORY         1024    // MB, for the memo table
 
 // playground colors
 #define GREEN_BG    "\x1b[30;1;42m"
@@ -27,9 +53,15 @@ typedef struct _word_node {
 #define DEFAULT     "\x1b[0m     "
 #define NORMAL      "\x1b[0;39m\n"
 
-// starting word sequences
-#define MAX_SEARCH_DEPTH    5
-#define MAX_SEARCH_WIDTH    3
+// starting word sequences: default and maximum width and depth of the
+// search (option -f), and number of words printed in each sequence
+#define SEARCH_WIDTH        3
+#define SEARCH_DEPTH        5
+#define MAX_SEARCH_WIDTH    64
+#define MAX_SEARCH_DEPTH    ( ALPHABET_SIZE / WORD_SIZE )
+
+// maximum number of word sets printed (option --word-sets)
+#define MAX_WORD_SETS       1000
 
 #define MAX_SEQUENCE_DEPTH  3
 
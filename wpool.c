@@ -0,0 +1,184 @@
+
+#include <stdio.h>
+#include <stdbool.h>
+#include <stdlib.h>
+#include <stdatomic.h>
+#include <unistd.h>
+#include <pthread.h>
+#include <assert.h>
+
+#include "wpool.h"
+
+/*
+    The pool threads wait for a new job generation. Once a job is posted, all
+    threads (including the submitting thread) claim chunks of items from a
+    shared atomic counter until the range is exhausted, so that faster threads
+    naturally take more chunks than slower ones.
+*/
+
+struct _thread_pool {
+    pthread_mutex_t job_lock;       // held by the thread submitting a job
+    pthread_mutex_t mutex;          // protects the following fields
+    pthread_cond_t  start, done;
+    unsigned long   generation;     // incremented for each new job
+    int             n_busy;         // pool threads still working on the job
+    bool            exit;
+
+    range_fct       f;              // current job
+    void            *ctxt;
+    int             n_items, chunk;
+    atomic_int      next;           // next item to process
+
+    int             n_threads;      // including the submitting thread
+    pthread_t       *threads;       // n_threads - 1 pool threads
+};
+
+typedef struct {
+    thread_pool *tp;
+    int         worker;
+} worker_arg;
+
+static void process_chunks( thread_pool *tp, int worker )
+{
+    while ( true ) {
+        int first = atomic_fetch_add( &tp->next, tp->chunk );
+        if ( first >= tp->n_items )
+            break;
+        int last = first + tp->chunk;
+        if ( last > tp->n_items )
+            last = tp->n_items;
+        tp->f( tp->ctxt, first, last, worker );
+    }
+}
+
+static void *pool_thread( void *arg )
+{
+    worker_arg *wa = arg;
+    thread_pool *tp = wa->tp;
+    int worker = wa->worker;
+    free( wa );
+
+    unsigned long generation = 0;
+    pthread_mutex_lock( &tp->mutex );
+    while ( true ) {
+        while ( ! tp->exit && generation == tp->generation ) {
+            pthread_cond_wait( &tp->start, &tp->mutex );
+        }
+        if ( tp->exit )
+            break;
+        generation = tp->generation;
+        pthread_mutex_unlock( &tp->mutex );
+
+        process_chunks( tp, worker );
+
+        pthread_mutex_lock( &tp->mutex );
+        if ( 0 == --tp->n_busy ) {
+            pthread_cond_signal( &tp->done );
+        }
+    }
+    pthread_mutex_unlock( &tp->mutex );
+    return NULL;
+}
+
+extern thread_pool *create_thread_pool( int n_threads )
+{
+    if ( n_threads <= 0 ) {
+        n_threads = (int)sysconf( _SC_NPROCESSORS_ONLN );
+        if ( n_threads <= 0 )
+            n_threads = 1;
+    }
+
+    thread_pool *tp = malloc( sizeof( thread_pool ) );
+    assert( tp );
+    pthread_mutex_init( &tp->job_lock, NULL );
+    pthread_mutex_init( &tp->mutex, NULL );
+    pthread_cond_init( &tp->start, NULL );
+    pthread_cond_init( &tp->done, NULL );
+    tp->generation = 0;
+    tp->n_busy = 0;
+    tp->exit = false;
+    tp->f = NULL;
+    tp->ctxt = NULL;
+    tp->n_items = 0;
+    tp->chunk = 1;
+    atomic_init( &tp->next, 0 );
+    tp->n_threads = n_threads;
+    tp->threads = NULL;
+
+    if ( n_threads > 1 ) {
+        tp->threads = malloc( sizeof( pthread_t ) * (n_threads - 1) );
+        assert( tp->threads );
+        for ( int i = 1; i < n_threads; ++i ) {
+            worker_arg *wa = malloc( sizeof( worker_arg ) );
+            assert( wa );
+            wa->tp = tp;
+            wa->worker = i;
+            if ( 0 != pthread_create( &tp->threads[i-1], NULL, pool_thread, wa ) ) {
+                printf( "wordle: failed to create pool thread\n" );
+                exit(1);
+            }
+        }
+    }
+    return tp;
+}
+
+extern int get_thread_pool_size( thread_pool *tp )
+{
+    return ( NULL == tp ) ? 1 : tp->n_threads;
+}
+
+extern void run_in_thread_pool( thread_pool *tp, int n_items, int chunk,
+                                range_fct f, void *ctxt )
+{
+    if ( n_items <= 0 )
+        return;
+    if ( chunk <= 0 )
+        chunk = 1;
+
+    if ( NULL == tp || 1 == tp->n_threads || n_items <= chunk ||
+         0 != pthread_mutex_trylock( &tp->job_lock ) ) {
+        f( ctxt, 0, n_items, 0 );   // run in calling thread
+        return;
+    }
+
+    pthread_mutex_lock( &tp->mutex );
+    tp->f = f;
+    tp->ctxt = ctxt;
+    tp->n_items = n_items;
+    tp->chunk = chunk;
+    atomic_store( &tp->next, 0 );
+    tp->n_busy = tp->n_threads - 1;
+    ++tp->generation;
+    pthread_cond_broadcast( &tp->start );
+    pthread_mutex_unlock( &tp->mutex );
+
+    process_chunks( tp, 0 );
+
+    pthread_mutex_lock( &tp->mutex );
+    while ( 0 != tp->n_busy ) {
+        pthread_cond_wait( &tp->done, &tp->mutex );
+    }
+    pthread_mutex_unlock( &tp->mutex );
+    pthread_mutex_unlock( &tp->job_lock );
+}
+
+extern void discard_thread_pool( thread_pool *tp )
+{
+    if ( NULL == tp )
+        return;
+
+    pthread_mutex_lock( &tp->mutex );
+    tp->exit = true;
+    pthread_cond_broadcast( &tp->start );
+    pthread_mutex_unlock( &tp->mutex );
+
+    for ( int i = 1; i < tp->n_threads; ++i ) {
+        pthread_join( tp->threads[i-1], NULL );
+    }
+    free( tp->threads );
+    pthread_cond_destroy( &tp->done );
+    pthread_cond_destroy( &tp->start );
+    pthread_mutex_destroy( &tp->mutex );
+    pthread_mutex_destroy( &tp->job_lock );
+    free( tp );
+}
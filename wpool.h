@@ -0,0 +1,33 @@
+
+#ifndef __WPOOL_H__
+#define __WPOOL_H__
+
+// A thread pool runs a single job at a time: the job is a range of items
+// [0, n_items) that is cut into chunks, and each chunk is processed by the
+// first available thread, including the thread that submitted the job. The
+// submitting thread returns only after all items have been processed.
+
+typedef struct _thread_pool thread_pool;
+
+// process items [first, last). worker is the index [0, n_threads) of the
+// thread processing those items, which allows using per-thread scratch data.
+typedef void (*range_fct)( void *ctxt, int first, int last, int worker );
+
+// create a pool of n_threads threads (including the calling thread). If
+// n_threads is 0 or negative, the number of online processors is used.
+extern thread_pool *create_thread_pool( int n_threads );
+
+// return the number of threads in the pool, including the calling thread,
+// or 1 if tp is NULL.
+extern int get_thread_pool_size( thread_pool *tp );
+
+// process all items in [0, n_items) by chunks of chunk items. If tp is NULL,
+// or if the pool is already busy with a job submitted by another thread, all
+// items are processed in the calling thread as worker 0.
+extern void run_in_thread_pool( thread_pool *tp, int n_items, int chunk,
+                                range_fct f, void *ctxt );
+
+// stop all threads and free the pool
+extern void discard_thread_pool( thread_pool *tp );
+
+#endif /* __WPOOL_H__ */
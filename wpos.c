@@ -1,11 +1,18 @@
 
 #include <stdio.h>
+#include <stdbool.h>
 #include <stdlib.h>
 #include <string.h>
 #include <assert.h>
 
+#if defined(__x86_64__) && defined(__SSE2__)
+#include <immintrin.h>
+#define X86_SIMD    1
+#endif
+
 #include "wdict.h"
 #include "wpos.h"
+#include "wmatrix.h"
 
 /*
     Contains code related to how letter positions are handled,
@@ -21,7 +28,9 @@
 // position and 'w' indicates that altough the letter at that position in word
 // belongs in ref, it does not appear at the same position in ref. It expects
 // pos to point to an array of WORD_SIZE+1 bytes, and does not allocate any
-// memory for it.
+// memory for it. If a feedback matrix is available (see wmatrix.h), the result
+// is obtained with a single lookup in the matrix, otherwise it is computed by
+// get_pattern_from_words below.
 //
 // Note that if the candidate word contains the same letter at multiple
 // positions, it may set different values in pos, depending on the case:
@@ -38,39 +47,218 @@ extern int get_position_from_words( const char *ref, const char *word,
                                      char *pos )
 {
     assert( WORD_SIZE == strnlen( ref, WORD_SIZE+ 1 ) );
-    char ref_tmp[WORD_SIZE+1];
-    strcpy( ref_tmp, ref );
-
     assert( WORD_SIZE == strnlen( word, WORD_SIZE+1 ) );
-    if ( ! is_word_in_dictionary( word ) ) {
+    int word_index = get_word_index( word );
+    if ( -1 == word_index ) {
         return -1;
-    }        
-    char word_tmp[WORD_SIZE+1];
-    strcpy( word_tmp, word );
+    }
 
-    memset( pos, '-', WORD_SIZE );
-    pos[WORD_SIZE] = 0;
+    int ref_index = -1;
+    if ( NO_MATRIX != get_feedback_matrix_type() ) {
+        ref_index = get_word_index( ref );
+    }
+    uint8_t pattern;
+    if ( -1 != ref_index ) {    // single lookup in feedback matrix
+        pattern = get_feedback( word_index, ref_index );
+    } else {
+        pattern = get_pattern_from_words( ref, word );
+    }
+    get_position_from_pattern( pattern, pos );
+    return 0;
+}
 
-    // 2 passes to reproduce NYT wordle behavior
+static const uint8_t pattern_weight[WORD_SIZE] = { 1, 3, 9, 27, 81 };
+
+// get_pattern_from_words does 2 passes to reproduce NYT wordle behavior: first
+// letters at the exact position in ref are set to 'r', then the remaining
+// letters in word are compared from left to right with the remaining letters
+// in ref, each remaining letter in ref being able to set only one 'w'. Instead
+// of erasing letters in copies of both words, it counts how many instances of
+// each letter are left in ref after the first pass.
+extern uint8_t get_pattern_from_words( const char *ref, const char *word )
+{
+    uint8_t remaining[ALPHABET_SIZE];   // ref letters not at exact position
+    memset( remaining, 0, ALPHABET_SIZE );
+    bool exact[WORD_SIZE];
+
+    uint8_t pattern = 0;
     for ( int i = 0; i < WORD_SIZE; ++i ) {
-        if ( word_tmp[i] == ref_tmp[i] ) {
-            pos[i] = 'r';
-            word_tmp[i] = ' ';  // remove letter at exact position
-            ref_tmp[i] = ' ';   // from word and ref
+        exact[i] = word[i] == ref[i];
+        if ( exact[i] ) {
+            pattern += 2 * pattern_weight[i];
+        } else {
+            ++remaining[ref[i] - 'a'];
         }
     }
     for ( int i = 0; i < WORD_SIZE; ++i ) {
-        if ( word_tmp[i] == ' ' ) {
-            continue;   // do not erase pos[i] if already set in previous pass
+        if ( ! exact[i] && remaining[word[i] - 'a'] > 0 ) {
+            --remaining[word[i] - 'a'];
+            pattern += pattern_weight[i];
         }
+    }
+    return pattern;
+}
 
-        char *ref_pos = strchr( ref_tmp, word_tmp[i] );
-        if ( NULL !=  ref_pos ) {
-            pos[i] = 'w';
-            *ref_pos = ' '; // remove letter at wrong position from ref
+/*
+    get_patterns_from_columns applies the same 2 passes to a whole block of
+    reference words at once. Each lane of a vector register holds the letter
+    at the same position in a different reference word, and conditions are
+    byte masks (0xff if true, 0 if false):
+    - exact[k] is set if the reference letter at k is the letter in word at k
+    - for each position i in word that is not exact, the number of remaining
+      instances of the letter word[i] in the reference (i.e. at positions that
+      are not exact) is compared with the number of instances of the same
+      letter at positions before i in word that are not exact either. Since the
+      second pass matches letters from left to right, the position i is set to
+      'w' only if there are more remaining instances in the reference than
+      previous instances in word.
+    Counting is done by subtracting masks (-1 if true). Patterns never exceed
+    242, so that the accumulation in bytes cannot overflow.
+*/
+#if X86_SIMD
+__attribute__((target("avx2")))
+static void get_patterns_avx2( const word_columns *refs, const char *word,
+                               uint8_t *patterns )
+{
+    const __m256i zero = _mm256_setzero_si256();
+    const __m256i ones = _mm256_set1_epi8( -1 );
+
+    for ( int base = 0; base < refs->n_words; base += 32 ) {
+        __m256i ref[WORD_SIZE], not_exact[WORD_SIZE];
+        __m256i pattern = zero;
+
+        for ( int k = 0; k < WORD_SIZE; ++k ) {
+            ref[k] = _mm256_load_si256( (const __m256i *)&refs->column[k][base] );
+            __m256i exact = _mm256_cmpeq_epi8( ref[k], _mm256_set1_epi8( word[k] ) );
+            not_exact[k] = _mm256_xor_si256( exact, ones );
+            pattern = _mm256_add_epi8( pattern, _mm256_and_si256( exact,
+                                _mm256_set1_epi8( 2 * pattern_weight[k] ) ) );
+        }
+        for ( int i = 0; i < WORD_SIZE; ++i ) {
+            __m256i letter = _mm256_set1_epi8( word[i] );
+            __m256i remaining = zero, previous = zero;
+            for ( int k = 0; k < WORD_SIZE; ++k ) {
+                remaining = _mm256_sub_epi8( remaining, _mm256_and_si256(
+                            _mm256_cmpeq_epi8( ref[k], letter ), not_exact[k] ) );
+            }
+            for ( int k = 0; k < i; ++k ) {
+                if ( word[k] == word[i] ) {
+                    previous = _mm256_sub_epi8( previous, not_exact[k] );
+                }
+            }
+            __m256i wrong = _mm256_and_si256( not_exact[i],
+                                    _mm256_cmpgt_epi8( remaining, previous ) );
+            pattern = _mm256_add_epi8( pattern, _mm256_and_si256( wrong,
+                                    _mm256_set1_epi8( pattern_weight[i] ) ) );
+        }
+
+        if ( base + 32 <= refs->n_words ) {
+            _mm256_storeu_si256( (__m256i *)&patterns[base], pattern );
+        } else {
+            uint8_t last[32];
+            _mm256_storeu_si256( (__m256i *)last, pattern );
+            memcpy( &patterns[base], last, refs->n_words - base );
         }
     }
-    return 0;
+}
+
+static void get_patterns_sse2( const word_columns *refs, const char *word,
+                               uint8_t *patterns )
+{
+    const __m128i zero = _mm_setzero_si128();
+    const __m128i ones = _mm_set1_epi8( -1 );
+
+    for ( int base = 0; base < refs->n_words; base += 16 ) {
+        __m128i ref[WORD_SIZE], not_exact[WORD_SIZE];
+        __m128i pattern = zero;
+
+        for ( int k = 0; k < WORD_SIZE; ++k ) {
+            ref[k] = _mm_load_si128( (const __m128i *)&refs->column[k][base] );
+            __m128i exact = _mm_cmpeq_epi8( ref[k], _mm_set1_epi8( word[k] ) );
+            not_exact[k] = _mm_xor_si128( exact, ones );
+            pattern = _mm_add_epi8( pattern, _mm_and_si128( exact,
+                                _mm_set1_epi8( 2 * pattern_weight[k] ) ) );
+        }
+        for ( int i = 0; i < WORD_SIZE; ++i ) {
+            __m128i letter = _mm_set1_epi8( word[i] );
+            __m128i remaining = zero, previous = zero;
+            for ( int k = 0; k < WORD_SIZE; ++k ) {
+                remaining = _mm_sub_epi8( remaining, _mm_and_si128(
+                            _mm_cmpeq_epi8( ref[k], letter ), not_exact[k] ) );
+            }
+            for ( int k = 0; k < i; ++k ) {
+                if ( word[k] == word[i] ) {
+                    previous = _mm_sub_epi8( previous, not_exact[k] );
+                }
+            }
+            __m128i wrong = _mm_and_si128( not_exact[i],
+                                    _mm_cmpgt_epi8( remaining, previous ) );
+            pattern = _mm_add_epi8( pattern, _mm_and_si128( wrong,
+                                    _mm_set1_epi8( pattern_weight[i] ) ) );
+        }
+
+        if ( base + 16 <= refs->n_words ) {
+            _mm_storeu_si128( (__m128i *)&patterns[base], pattern );
+        } else {
+            uint8_t last[16];
+            _mm_storeu_si128( (__m128i *)last, pattern );
+            memcpy( &patterns[base], last, refs->n_words - base );
+        }
+    }
+}
+#endif
+
+extern void get_patterns_from_columns( const word_columns *refs,
+                                       const char *word, uint8_t *patterns )
+{
+    assert( WORD_SIZE == strnlen( word, WORD_SIZE+1 ) );
+#if X86_SIMD
+    if ( __builtin_cpu_supports( "avx2" ) ) {
+        get_patterns_avx2( refs, word, patterns );
+    } else {
+        get_patterns_sse2( refs, word, patterns );
+    }
+#else
+    char ref[WORD_SIZE+1];
+    ref[WORD_SIZE] = 0;
+    for ( int i = 0; i < refs->n_words; ++i ) {
+        for ( int k = 0; k < WORD_SIZE; ++k ) {
+            ref[k] = refs->column[k][i];
+        }
+        patterns[i] = get_pattern_from_words( ref, word );
+    }
+#endif
+}
+
+extern void get_position_from_pattern( uint8_t pattern, char *pos )
+{
+    static const char codes[3] = { '-', 'w', 'r' };
+    for ( int i = 0; i < WORD_SIZE; ++i ) {
+        pos[i] = codes[pattern % 3];
+        pattern /= 3;
+    }
+    pos[WORD_SIZE] = 0;
+}
+
+extern bool get_pattern_from_data( const char *data, char *word,
+                                   uint8_t *pattern )
+{
+    unsigned int value = 0, unit = 1;
+    for ( int k = 0; k < WORD_SIZE; ++k, unit *= 3 ) {
+        word[k] = data[2*k+1];
+        if ( word[k] < 'a' || word[k] > 'z' ) {
+            return false;
+        }
+        switch ( data[2*k] ) {
+        case 'r': value += 2 * unit; break;
+        case 'w': value += unit; break;
+        case 'n': break;
+        default: return false;
+        }
+    }
+    word[WORD_SIZE] = 0;
+    *pattern = (uint8_t)value;
+    return true;
 }
 
 /*
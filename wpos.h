@@ -2,6 +2,9 @@
 #ifndef __WPOS_H__
 #define __WPOS_H__
 
+#include <stdbool.h>
+#include <stdint.h>
+#include "wdict.h"
 #include "wsolve.h"
 
 // consume 10 bytes of data at a time, update solver_data known, required, out
@@ -19,4 +22,31 @@ extern solver_data_status update_solver_data( solver_data *sd,
 extern int get_position_from_words( const char *ref, const char *word,
                                     char *pos );
 
+// Feedback patterns are encoded in base 3, one digit per position with the
+// first letter as the least significant digit: 0 for '-', 1 for 'w' and 2 for
+// 'r'. A pattern fits in one byte [0-242], WINNING_PATTERN being "rrrrr".
+
+// return the feedback pattern obtained when trying word against ref. Unlike
+// get_position_from_words, it does not check if word is in the dictionary.
+extern uint8_t get_pattern_from_words( const char *ref, const char *word );
+
+// compute in one pass the feedback patterns obtained when trying word against
+// each of the words in refs, and store them in patterns, which must be able to
+// hold refs->n_words patterns. The result is identical to calling
+// get_pattern_from_words for each word in refs, but it is computed by blocks
+// of 16 or 32 words at a time with SSE2 or AVX2 instructions if available.
+extern void get_patterns_from_columns( const word_columns *refs,
+                                       const char *word, uint8_t *patterns );
+
+// convert a feedback pattern into a position string as described above.
+// Expect pos to point to an array of WORD_SIZE+1 bytes
+extern void get_position_from_pattern( uint8_t pattern, char *pos );
+
+// convert the first row of 10 bytes in a data string (see update_solver_data)
+// into the word tried and the feedback pattern obtained. Return false if the
+// row is not made of valid codes and letters. Expect word to point to an
+// array of WORD_SIZE+1 bytes.
+extern bool get_pattern_from_data( const char *data, char *word,
+                                   uint8_t *pattern );
+
 #endif /* __WPOS_H__ */
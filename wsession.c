@@ -0,0 +1,198 @@
+
+#include <stdio.h>
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <pthread.h>
+#include <assert.h>
+
+#include "wdict.h"
+#include "wsession.h"
+
+/*
+    Sessions are kept in a hash table of SESSION_BUCKETS chains, indexed by a
+    hash of the session id, and in a list ordered by last use, from the newest
+    to the oldest session. Expired sessions and sessions over the memory limit
+    are always at the old end of the list, so that they are removed first,
+    each time a session is looked up or updated. A single mutex protects all
+    sessions, since it is only held while copying a few survivors.
+*/
+
+#define SESSION_BUCKETS     1024            // must be a power of 2
+#define MAX_DATA_SIZE       (MAX_TRIES * 2 * WORD_SIZE)
+
+typedef struct _session {
+    struct _session *next;              // in the same bucket
+    struct _session *newer, *older;     // in the list ordered by last use
+    time_t          last_used;
+    size_t          size;               // memory used by the session
+    int             n_words;            // survivors
+    int             *indexes;
+    char            id[MAX_SESSION_ID_SIZE+1];
+    char            data[MAX_DATA_SIZE+1];
+} session;
+
+static pthread_mutex_t  s_lock = PTHREAD_MUTEX_INITIALIZER;
+static session          *s_buckets[SESSION_BUCKETS];
+static session          *s_newest, *s_oldest;
+static size_t           s_memory, s_max_memory;
+static int              s_ttl;
+
+static time_t get_time( void )
+{
+    struct timespec ts;
+    clock_gettime( CLOCK_MONOTONIC, &ts );
+    return ts.tv_sec;
+}
+
+static session **get_bucket( const char *id )
+{
+    uint32_t hash = 2166136261u;    // FNV-1a
+    for ( ; *id; ++id ) {
+        hash = ( hash ^ (uint8_t)*id ) * 16777619u;
+    }
+    return &s_buckets[ hash & ( SESSION_BUCKETS - 1 ) ];
+}
+
+static session *find_session( const char *id )
+{
+    for ( session *s = *get_bucket( id ); s; s = s->next ) {
+        if ( 0 == strcmp( s->id, id ) ) {
+            return s;
+        }
+    }
+    return NULL;
+}
+
+static void unlink_session( session *s )
+{
+    if ( s->newer ) s->newer->older = s->older;
+    else            s_newest = s->older;
+    if ( s->older ) s->older->newer = s->newer;
+    else            s_oldest = s->newer;
+}
+
+static void set_newest_session( session *s, time_t now )
+{
+    s->last_used = now;
+    s->newer = NULL;
+    s->older = s_newest;
+    if ( s_newest ) s_newest->newer = s;
+    else            s_oldest = s;
+    s_newest = s;
+}
+
+static void remove_session( session *s )
+{
+    session **pp = get_bucket( s->id );
+    while ( *pp != s ) {
+        pp = &(*pp)->next;
+    }
+    *pp = s->next;
+    unlink_session( s );
+    s_memory -= s->size;
+    free( s->indexes );
+    free( s );
+}
+
+static void expire_sessions( time_t now )
+{
+    while ( NULL != s_oldest &&
+            ( now - s_oldest->last_used > s_ttl || s_memory > s_max_memory ) ) {
+        remove_session( s_oldest );
+    }
+}
+
+static bool is_valid_session_id( const char *id )
+{
+    size_t len = strnlen( id, MAX_SESSION_ID_SIZE+1 );
+    return len > 0 && len <= MAX_SESSION_ID_SIZE;
+}
+
+extern void init_sessions( int ttl, size_t max_memory )
+{
+    discard_sessions( );
+    pthread_mutex_lock( &s_lock );
+    s_ttl = ttl;
+    s_max_memory = max_memory;
+    pthread_mutex_unlock( &s_lock );
+}
+
+extern bool get_session_solutions( const char *id, const char *data,
+                                   const solver_data *given, arena *a,
+                                   word_span *result )
+{
+    if ( ! is_valid_session_id( id ) ) {
+        return false;
+    }
+
+    time_t now = get_time( );
+    pthread_mutex_lock( &s_lock );
+    expire_sessions( now );
+    session *s = find_session( id );
+    size_t len = ( NULL == s ) ? 0 : strlen( s->data );
+    if ( NULL == s || 0 != strncmp( s->data, data, len ) ) {
+        pthread_mutex_unlock( &s_lock );
+        return false;
+    }
+
+    result->indexes = arena_alloc( a, sizeof( int ) * ( s->n_words + 1 ) );
+    result->n_words = 0;
+    for ( int i = 0; i < s->n_words; ++i ) {
+        int index = s->indexes[i];
+        if ( does_word_match( given, get_nth_word_in_dictionary( index ) ) ) {
+            result->indexes[result->n_words++] = index;
+        }
+    }
+    unlink_session( s );
+    set_newest_session( s, now );
+    pthread_mutex_unlock( &s_lock );
+    return true;
+}
+
+extern void set_session_solutions( const char *id, const char *data,
+                                   const word_span *result )
+{
+    if ( ! is_valid_session_id( id ) || strlen( data ) > MAX_DATA_SIZE ) {
+        return;
+    }
+
+    int *indexes = malloc( sizeof( int ) * ( result->n_words + 1 ) );
+    assert( indexes );
+    memcpy( indexes, result->indexes, sizeof( int ) * result->n_words );
+
+    time_t now = get_time( );
+    pthread_mutex_lock( &s_lock );
+    session *s = find_session( id );
+    if ( NULL == s ) {
+        s = malloc( sizeof( session ) );
+        assert( s );
+        strcpy( s->id, id );
+        session **bucket = get_bucket( id );
+        s->next = *bucket;
+        *bucket = s;
+    } else {
+        unlink_session( s );
+        s_memory -= s->size;
+        free( s->indexes );
+    }
+    strcpy( s->data, data );
+    s->n_words = result->n_words;
+    s->indexes = indexes;
+    s->size = sizeof( session ) + sizeof( int ) * result->n_words;
+    s_memory += s->size;
+    set_newest_session( s, now );
+    expire_sessions( now );
+    pthread_mutex_unlock( &s_lock );
+}
+
+extern void discard_sessions( void )
+{
+    pthread_mutex_lock( &s_lock );
+    while ( NULL != s_oldest ) {
+        remove_session( s_oldest );
+    }
+    pthread_mutex_unlock( &s_lock );
+}
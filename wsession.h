@@ -0,0 +1,43 @@
+
+#ifndef __WSESSION_H__
+#define __WSESSION_H__
+
+#include <stdbool.h>
+#include <stddef.h>
+#include "wordle.h"
+#include "wset.h"
+#include "wsolve.h"
+
+// A solver session keeps, for a session id given by the client, the data
+// string of the last request and the words that matched it (the survivors).
+// When the next request for the same session extends that data string with
+// new rows, only the survivors need to be checked against the new data,
+// instead of solving again from the whole dictionary. Sessions expire after
+// a given time without use, and the oldest sessions are dropped when the
+// total memory used by sessions exceeds a given maximum. All functions can
+// be called concurrently from multiple threads.
+
+#define MAX_SESSION_ID_SIZE     64
+
+// initialize sessions, which expire after ttl seconds without use, and take
+// at most max_memory bytes in total.
+extern void init_sessions( int ttl, size_t max_memory );
+
+// if the session id exists and its data string is a prefix of data, set
+// result with the survivors that match given, which must have been set with
+// the same data (see set_solver_data in wsolve.h), and return true. The span
+// is allocated in the given arena. Otherwise return false: the solutions
+// must be obtained from the whole dictionary (see get_solution_span).
+extern bool get_session_solutions( const char *id, const char *data,
+                                   const solver_data *given, arena *a,
+                                   word_span *result );
+
+// create or update the session id with the given data string and the
+// matching words in result.
+extern void set_session_solutions( const char *id, const char *data,
+                                   const word_span *result );
+
+// free all sessions.
+extern void discard_sessions( void );
+
+#endif /* __WSESSION_H__ */
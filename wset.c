@@ -0,0 +1,114 @@
+
+#include <stdio.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+#include <assert.h>
+
+#include "wset.h"
+
+extern void init_word_set( word_set *ws, int n_words )
+{
+    ws->n_words = n_words;
+    ws->n_blocks = ( n_words + 63 ) / 64;
+    ws->bits = calloc( ws->n_blocks ? ws->n_blocks : 1, sizeof( uint64_t ) );
+    assert( ws->bits );
+}
+
+extern void init_word_set_in_arena( word_set *ws, int n_words, arena *a )
+{
+    ws->n_words = n_words;
+    ws->n_blocks = ( n_words + 63 ) / 64;
+    ws->bits = arena_alloc( a, sizeof( uint64_t ) * ws->n_blocks );
+    clear_word_set( ws );
+}
+
+extern void fill_word_set( word_set *ws )
+{
+    memset( ws->bits, 0xff, sizeof( uint64_t ) * ws->n_blocks );
+    if ( ws->n_words % 64 ) {   // clear bits beyond n_words in last block
+        ws->bits[ ws->n_blocks - 1 ] = ( (uint64_t)1 << ( ws->n_words % 64 ) ) - 1;
+    }
+}
+
+extern void clear_word_set( word_set *ws )
+{
+    memset( ws->bits, 0, sizeof( uint64_t ) * ws->n_blocks );
+}
+
+extern void add_to_word_set( word_set *ws, int index )
+{
+    assert( index >= 0 && index < ws->n_words );
+    ws->bits[ index / 64 ] |= (uint64_t)1 << ( index % 64 );
+}
+
+extern void and_word_set( word_set *ws, const word_set *other )
+{
+    assert( ws->n_blocks == other->n_blocks );
+    for ( int i = 0; i < ws->n_blocks; ++i ) {
+        ws->bits[i] &= other->bits[i];
+    }
+}
+
+extern void and_not_word_set( word_set *ws, const word_set *other )
+{
+    assert( ws->n_blocks == other->n_blocks );
+    for ( int i = 0; i < ws->n_blocks; ++i ) {
+        ws->bits[i] &= ~other->bits[i];
+    }
+}
+
+extern int get_word_set_count( const word_set *ws )
+{
+    int count = 0;
+    for ( int i = 0; i < ws->n_blocks; ++i ) {
+        count += __builtin_popcountll( ws->bits[i] );
+    }
+    return count;
+}
+
+extern int get_word_set_indexes( const word_set *ws, int *indexes )
+{
+    int n = 0;
+    for ( int i = 0; i < ws->n_blocks; ++i ) {
+        for ( uint64_t bits = ws->bits[i]; bits; bits &= bits - 1 ) {
+            indexes[n++] = i * 64 + __builtin_ctzll( bits );
+        }
+    }
+    return n;
+}
+
+extern void discard_word_set( word_set *ws )
+{
+    free( ws->bits );
+    ws->bits = NULL;
+    ws->n_words = ws->n_blocks = 0;
+}
+
+extern void get_word_set_span( const word_set *ws, arena *a, word_span *span )
+{
+    span->n_words = get_word_set_count( ws );
+    span->indexes = arena_alloc( a, sizeof( int ) * span->n_words );
+    get_word_set_indexes( ws, span->indexes );
+}
+
+extern void init_word_set_iterator( word_set_iterator *wsi, const word_set *ws )
+{
+    wsi->ws = ws;
+    wsi->block = 0;
+    wsi->bits = ( ws->n_blocks > 0 ) ? ws->bits[0] : 0;
+}
+
+extern int get_next_word_in_set( word_set_iterator *wsi )
+{
+    while ( 0 == wsi->bits ) {
+        if ( ++wsi->block >= wsi->ws->n_blocks ) {
+            wsi->block = wsi->ws->n_blocks;
+            return -1;
+        }
+        wsi->bits = wsi->ws->bits[ wsi->block ];
+    }
+    int index = wsi->block * 64 + __builtin_ctzll( wsi->bits );
+    wsi->bits &= wsi->bits - 1;     // remove lowest bit
+    return index;
+}
@@ -0,0 +1,70 @@
+
+#ifndef __WSET_H__
+#define __WSET_H__
+
+#include <stdint.h>
+#include "warena.h"
+
+// A word set is a bitset over dictionary indexes: bit i is set if the word at
+// index i in dictionary belongs to the set. Set operations are done 64 words
+// at a time.
+
+typedef struct {
+    int      n_words;       // number of bits in set
+    int      n_blocks;      // number of 64-bit blocks
+    uint64_t *bits;
+} word_set;
+
+// allocate an empty set for indexes in [0, n_words)
+extern void init_word_set( word_set *ws, int n_words );
+
+// allocate an empty set for indexes in [0, n_words) in the given arena. The
+// set is freed with the arena and discard_word_set must not be called.
+extern void init_word_set_in_arena( word_set *ws, int n_words, arena *a );
+
+// add all indexes in [0, n_words) to the set
+extern void fill_word_set( word_set *ws );
+
+// remove all indexes from the set
+extern void clear_word_set( word_set *ws );
+
+extern void add_to_word_set( word_set *ws, int index );
+
+// set operations: ws = ws & other, or ws = ws & ~other (both sets must have
+// the same size).
+extern void and_word_set( word_set *ws, const word_set *other );
+extern void and_not_word_set( word_set *ws, const word_set *other );
+
+// return the number of indexes in the set
+extern int get_word_set_count( const word_set *ws );
+
+// copy all indexes in the set in increasing order into indexes, which must
+// be large enough, and return the number of indexes copied.
+extern int get_word_set_indexes( const word_set *ws, int *indexes );
+
+extern void discard_word_set( word_set *ws );
+
+// iterate over the indexes in a set in increasing order:
+// word_set_iterator wsi;
+// init_word_set_iterator( &wsi, ws );
+// for ( int index; -1 != ( index = get_next_word_in_set( &wsi ) ); ) { ... }
+typedef struct {
+    const word_set  *ws;
+    int             block;      // current block
+    uint64_t        bits;       // bits not yet returned in current block
+} word_set_iterator;
+
+extern void init_word_set_iterator( word_set_iterator *wsi, const word_set *ws );
+extern int get_next_word_in_set( word_set_iterator *wsi );
+
+// A word span is a contiguous array of dictionary indexes with a known length.
+// It is allocated in an arena given by the caller and freed with the arena.
+typedef struct {
+    int n_words;
+    int *indexes;           // in increasing order
+} word_span;
+
+// set span with all indexes in the set, allocated in the given arena.
+extern void get_word_set_span( const word_set *ws, arena *a, word_span *span );
+
+#endif /* __WSET_H__ */
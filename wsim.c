@@ -0,0 +1,174 @@
+
+#include <stdio.h>
+#include <stdbool.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <assert.h>
+
+#include "wsim.h"
+#include "wdict.h"
+#include "wpos.h"
+#include "wsolve.h"
+
+/*
+    Each game is played in a single thread, with the suggestion engine
+    initialized without thread pool, and games are distributed by chunks in
+    the thread pool. Each thread has its own solver data, arena and results,
+    which are summed at the end. The first word tried is the same in all
+    games, so that it is computed only once.
+*/
+
+#define SIM_CHUNK       4       // games per chunk
+
+typedef struct {
+    int         n_won[MAX_TRIES+1];     // n_won[t]: games won in t tries
+    int         n_lost;
+    solver_data given;
+    arena       a;
+} sim_worker;
+
+typedef struct {
+    suggest_strategy    strategy;
+    const char          *first;         // first word tried
+    sim_worker          *workers;
+} sim_ctxt;
+
+extern int play_game( suggest_strategy strategy, const char *first,
+                      const char *answer, solver_data *given, arena *a,
+                      char *data )
+{
+    const char *guess = first;
+    for ( int tries = 1; tries <= MAX_TRIES; ++tries ) {
+        char position[WORD_SIZE+1];
+        get_position_from_words( answer, guess, position );
+        char *row = &data[ ( tries - 1 ) * 2 * WORD_SIZE ];
+        for ( int k = 0; k < WORD_SIZE; ++k ) {
+            row[2*k] = ( '-' == position[k] ) ? 'n' : position[k];
+            row[2*k+1] = guess[k];
+        }
+        row[2*WORD_SIZE] = 0;
+
+        if ( 0 == strncmp( guess, answer, WORD_SIZE ) ) {
+            return tries;
+        }
+        if ( MAX_TRIES == tries ) {
+            break;
+        }
+
+        reset_solver_data( given );
+        if ( SOLVER_DATA_SET != set_solver_data( given, data ) ) {
+            printf( "wordle: invalid data %s while looking for %s\n", data, answer );
+            exit(1);
+        }
+        reset_arena( a );
+        word_span candidates;
+        get_solution_span( given, a, &candidates );
+        assert( candidates.n_words > 0 );
+
+        suggestion best;
+        if ( 0 != get_suggestions( &candidates, strategy, 1, a, &best ) ) {
+            guess = best.word;
+        } else {
+            guess = get_nth_word_in_dictionary( candidates.indexes[0] );
+        }
+    }
+    return 0;
+}
+
+static void play_games( void *ctxt, int first, int last, int worker )
+{
+    const sim_ctxt *sc = ctxt;
+    sim_worker *sw = &sc->workers[worker];
+    char data[ MAX_TRIES * 2 * WORD_SIZE + 1 ];
+    for ( int i = first; i < last; ++i ) {
+        int tries = play_game( sc->strategy, sc->first,
+                               get_nth_word_in_dictionary( i ),
+                               &sw->given, &sw->a, data );
+        if ( 0 == tries ) {
+            ++sw->n_lost;
+        } else {
+            ++sw->n_won[tries];
+        }
+    }
+}
+
+static double get_elapsed( const struct timespec *start )
+{
+    struct timespec now;
+    clock_gettime( CLOCK_MONOTONIC, &now );
+    return (double)( now.tv_sec - start->tv_sec ) +
+           (double)( now.tv_nsec - start->tv_nsec ) / 1e9;
+}
+
+extern void simulate_games( thread_pool *tp, suggest_strategy strategy,
+                            const char *start )
+{
+    int n_words = get_dictionary_size();
+    size_t arena_size = sizeof(int) * 4 * ( n_words + 64 );
+
+    struct timespec begin;
+    clock_gettime( CLOCK_MONOTONIC, &begin );
+
+    sim_ctxt sc;
+    sc.strategy = strategy;
+    sc.first = start;
+    arena a;
+    init_arena( &a, arena_size );
+    if ( NULL == sc.first ) {
+        word_span all;
+        all.n_words = n_words;
+        all.indexes = arena_alloc( &a, sizeof(int) * n_words );
+        for ( int i = 0; i < n_words; ++i ) {
+            all.indexes[i] = i;
+        }
+        init_suggestions( tp, 0 );
+        suggestion best;
+        sc.first = ( 0 != get_suggestions( &all, strategy, 1, &a, &best ) ) ?
+                    best.word : get_nth_word_in_dictionary( 0 );
+    }
+    double first_time = get_elapsed( &begin );
+
+    int n_workers = get_thread_pool_size( tp );
+    sc.workers = malloc( sizeof(sim_worker) * n_workers );
+    assert( sc.workers );
+    for ( int w = 0; w < n_workers; ++w ) {
+        memset( sc.workers[w].n_won, 0, sizeof(sc.workers[w].n_won) );
+        sc.workers[w].n_lost = 0;
+        init_solver_data( &sc.workers[w].given );
+        init_arena( &sc.workers[w].a, arena_size );
+    }
+
+    init_suggestions( NULL, 0 );
+    run_in_thread_pool( tp, n_words, SIM_CHUNK, play_games, &sc );
+    init_suggestions( tp, 0 );
+    double elapsed = get_elapsed( &begin );
+
+    int n_won[MAX_TRIES+1] = { 0 };
+    int n_lost = 0;
+    for ( int w = 0; w < n_workers; ++w ) {
+        for ( int t = 1; t <= MAX_TRIES; ++t ) {
+            n_won[t] += sc.workers[w].n_won[t];
+        }
+        n_lost += sc.workers[w].n_lost;
+        discard_solver_data( &sc.workers[w].given );
+        discard_arena( &sc.workers[w].a );
+    }
+    free( sc.workers );
+
+    int n_games = n_words - n_lost, total = 0;
+    printf( "Strategy %s, starting with %s:\n", get_strategy_name( strategy ), sc.first );
+    for ( int t = 1; t <= MAX_TRIES; ++t ) {
+        printf( "  %d %s %6d  %6.2f%%\n", t, ( 1 == t ) ? "try:  " : "tries:",
+                n_won[t], (double)( n_won[t] * 100 ) / (double)n_words );
+        total += t * n_won[t];
+    }
+    printf( "  failed:  %6d  %6.2f%%\n", n_lost,
+            (double)( n_lost * 100 ) / (double)n_words );
+    printf( "  average: %.4f tries per game won\n",
+            ( 0 == n_games ) ? 0.0 : (double)total / (double)n_games );
+    printf( "  time:    %.3f s for %d games (%.3f s for the first word), "
+            "%.3f ms per game, %d thread(s)\n", elapsed, n_words, first_time,
+            elapsed * 1000.0 / (double)n_words, n_workers );
+    discard_arena( &a );
+}
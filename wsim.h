@@ -0,0 +1,39 @@
+
+#ifndef __WSIM_H__
+#define __WSIM_H__
+
+#include "wordle.h"
+#include "warena.h"
+#include "wpool.h"
+#include "wsolve.h"
+#include "wsuggest.h"
+
+// A simulation plays a game for each word in the dictionary as the word to
+// guess, the way a player following the solver would: after each try, the
+// feedback is added to the data string (see wsolve.h), the candidates left
+// are computed from it and the suggested word (see wsuggest.h) is tried next,
+// or the first candidate if there are less than 3 of them. It measures both
+// the quality of a strategy (the number of tries needed) and the speed of the
+// solver (the time needed per game).
+
+// play a single game for answer with the given strategy, starting with first,
+// using given and a as scratch. Return the number of tries needed to find
+// answer, or 0 if it was not found in MAX_TRIES tries, and set data to the
+// data string of all rows tried, including the last one, which must hold at
+// least MAX_TRIES * 2 * WORD_SIZE + 1 characters. The suggestion engine must
+// have been initialized before.
+extern int play_game( suggest_strategy strategy, const char *first,
+                      const char *answer, solver_data *given, arena *a,
+                      char *data );
+
+// play all games with the given strategy, starting with the given word, or
+// with the word suggested for the whole dictionary if start is NULL, and
+// print the number of games won in each number of tries, the number of games
+// not won in MAX_TRIES tries, the average number of tries and the time per
+// game. Games are played in parallel in the given thread pool (or in the
+// calling thread only if tp is NULL), each game in a single thread. The
+// suggestion engine is left initialized with tp and no time limit.
+extern void simulate_games( thread_pool *tp, suggest_strategy strategy,
+                            const char *start );
+
+#endif /* __WSIM_H__ */
@@ -4,81 +4,352 @@
 #include <string.h>
 #include <assert.h>
 
+#if defined(__x86_64__)
+#include <immintrin.h>
+#define X86_SIMD    1
+#endif
+
 #include "wdict.h"
 #include "wpos.h"
 #include "wsolve.h"
 
-typedef struct {
-    word_node       *subset;            // current subset
-    char            *out;               // definitely not in
-    char            *known;             // must be @ position
-    char            *required;          // required but
-    char            *wrong[WORD_SIZE];  // must not be @ position
-    int             *required_count;    // required letter counts
-    int             n_required;
-} subset_constraints;
+#define ALL_LETTERS     ((1u << ALPHABET_SIZE) - 1)
 
-static void match( void *ctxt, const char *word )
+/*
+    The compiled constraint is built directly from each row of data, rather
+    than from known, required and out, since for each attempted word the
+    feedback gives exactly:
+    - at a position marked 'r', the only letter allowed,
+    - at a position marked 'w' or 'n', a letter that is not allowed (if it was
+      there, the position would have been marked 'r'),
+    - for each letter, the number of instances marked 'r' or 'w' in the row is
+      the minimum number of instances in the word, and if one instance of the
+      same letter is marked 'n', it is also the maximum number of instances.
+    Rows are combined by intersecting the allowed masks, and keeping the
+    largest minimum and the smallest maximum for each letter. Finally letters
+    that cannot appear at all are removed from all allowed masks, so that only
+    the letters with a count that must really be checked are listed in counted.
+    If rows contradict each other, e.g. a letter marked 'w' in a row and only
+    'n' in a later row, a minimum count is above the maximum count and no word
+    can match: all allowed masks are then cleared.
+*/
+static void compile_row( solver_constraint *sc, const char *data )
 {
-    subset_constraints *sc = ctxt;
+    uint8_t n_in_row[ALPHABET_SIZE];        // instances marked 'r' or 'w'
+    memset( n_in_row, 0, ALPHABET_SIZE );
+    uint32_t bounded = 0;                   // letters with an instance 'n'
+
+    for ( int k = 0; k < WORD_SIZE; ++k ) {
+        int l = data[2*k+1] - 'a';
+        switch ( data[2*k] ) {
+        case 'r':
+            sc->allowed[k] &= 1u << l;
+            ++n_in_row[l];
+            break;
+        case 'w':
+            sc->allowed[k] &= ~(1u << l);
+            ++n_in_row[l];
+            break;
+        default:
+            sc->allowed[k] &= ~(1u << l);
+            bounded |= 1u << l;
+            break;
+        }
+    }
+    for ( int l = 0; l < ALPHABET_SIZE; ++l ) {
+        if ( sc->min_count[l] < n_in_row[l] ) {
+            sc->min_count[l] = n_in_row[l];
+        }
+        if ( ( bounded & (1u << l) ) && sc->max_count[l] > n_in_row[l] ) {
+            sc->max_count[l] = n_in_row[l];
+        }
+    }
+}
 
-//    printf( "word: %s required: %s known: %s out: %s\n",
-//            word, sc->required, sc->known, sc->out );
-    int required_count[WORD_SIZE]; // local copy (modifed inside function)
-    memcpy( required_count, sc->required_count, sizeof( int ) * WORD_SIZE );
+static void compile_solver_constraint( solver_constraint *sc )
+{
+    uint32_t excluded = 0;
+    bool conflicting = false;
+    for ( int l = 0; l < ALPHABET_SIZE; ++l ) {
+        if ( 0 == sc->max_count[l] ) {
+            excluded |= 1u << l;
+        }
+        conflicting |= sc->min_count[l] > sc->max_count[l];
+    }
 
-    // for each position in word
-    for ( int i = 0; i < WORD_SIZE; ++i ) {
-        // first check if required letter at that position
-        if ( sc->known[i] != '-' ) {
-            // if not the same as candidate letter at that position
-            if ( sc->known[i] != word[i] ) {
-                return;     // reject candidate
-            }   // otherwise match, move to next letter
-        } else {    // no required letter at that position
-                        // check if required at some other position
-            char *rlp = strchr( sc->required, word[i] );
-            if ( rlp ) {    // letter is potentially required
-                if ( sc->wrong[i] && strchr( sc->wrong[i], word[i] ) ) {
-                    return; // letter at wrong position: reject candidate
-                }
-                int rli = rlp-sc->required;
-                if ( required_count[rli] > 0 ) { // instance still possible
-                    -- required_count[rli];
-                    continue;       // accept instance and move to next letter
-                }
+    sc->n_counted = 0;
+    if ( conflicting ) {
+        memset( sc->allowed, 0, sizeof( sc->allowed ) );
+        return;
+    }
+    for ( int k = 0; k < WORD_SIZE; ++k ) {
+        sc->allowed[k] &= ~excluded;
+    }
+    for ( int l = 0; l < ALPHABET_SIZE; ++l ) {
+        if ( 0 == ( excluded & (1u << l) ) &&
+             ( sc->min_count[l] > 0 || sc->max_count[l] < WORD_SIZE ) ) {
+            sc->counted[ sc->n_counted++ ] = (uint8_t)l;
+        }
+    }
+}
+
+static void clear_solver_constraint( solver_constraint *sc )
+{
+    for ( int k = 0; k < WORD_SIZE; ++k ) {
+        sc->allowed[k] = ALL_LETTERS;
+    }
+    memset( sc->min_count, 0, ALPHABET_SIZE );
+    memset( sc->max_count, WORD_SIZE, ALPHABET_SIZE );
+    sc->n_counted = 0;
+}
+
+// accumulate rejections in a mask instead of returning at the first failed
+// check, so that the only branch is the final test.
+extern bool does_word_match( const solver_data *given, const char *word )
+{
+    const solver_constraint *sc = &given->constraint;
+
+    uint32_t rejected = 0;
+    for ( int k = 0; k < WORD_SIZE; ++k ) {
+        rejected |= ~sc->allowed[k] & (1u << (word[k] - 'a'));
+    }
+    for ( int i = 0; i < sc->n_counted; ++i ) {
+        int l = sc->counted[i];
+        int n = 0;
+        for ( int k = 0; k < WORD_SIZE; ++k ) {
+            n += ( word[k] - 'a' == l );
+        }
+        rejected |= ( n < sc->min_count[l] ) | ( n > sc->max_count[l] );
+    }
+    return 0 == rejected;
+}
+
+/*
+    get_matching_words_in_columns checks 32 words at a time, with one byte
+    per word in AVX2 registers:
+    - the mask of allowed letters at each position is turned into 2 tables of
+      16 bytes (0xff if allowed, 0 if not), for letters [a-p] and [q-z], which
+      are looked up with the letter in each column as an index,
+    - the number of instances of each counted letter is obtained by summing
+      the comparisons of each column with that letter (-1 if equal), and is
+      compared with the minimum and maximum counts,
+    - words must include all letters with a minimum count of at least 1, which
+      is checked 8 words at a time with the letter masks, so that only the
+      letters with a minimum count above 1 or a maximum count are counted.
+*/
+#if X86_SIMD
+__attribute__((target("avx2")))
+static void match_columns_avx2( const solver_constraint *sc,
+                                const word_columns *wc, word_set *result )
+{
+    __m256i low[WORD_SIZE], high[WORD_SIZE];
+    for ( int k = 0; k < WORD_SIZE; ++k ) {
+        char table[2][32];
+        for ( int l = 0; l < 16; ++l ) {
+            table[0][l] = table[0][l+16] = ( sc->allowed[k] & (1u << l) ) ? -1 : 0;
+            table[1][l] = table[1][l+16] =
+                ( l + 16 < ALPHABET_SIZE && ( sc->allowed[k] & (1u << (l+16)) ) ) ? -1 : 0;
+        }
+        low[k] = _mm256_loadu_si256( (const __m256i *)table[0] );
+        high[k] = _mm256_loadu_si256( (const __m256i *)table[1] );
+    }
+
+    uint32_t required = 0;
+    int n_counted = 0;
+    uint8_t counted[ALPHABET_SIZE];
+    for ( int i = 0; i < sc->n_counted; ++i ) {
+        int l = sc->counted[i];
+        if ( sc->min_count[l] > 0 ) {
+            required |= 1u << l;
+        }
+        if ( sc->min_count[l] > 1 || sc->max_count[l] < WORD_SIZE ) {
+            counted[n_counted++] = (uint8_t)l;
+        }
+    }
+
+    const __m256i first = _mm256_set1_epi8( 'a' );
+    const __m256i fifteen = _mm256_set1_epi8( 15 );
+    const __m256i sixteen = _mm256_set1_epi8( 16 );
+    const __m256i all_required = _mm256_set1_epi32( (int)required );
+
+    clear_word_set( result );
+    for ( int base = 0; base < wc->n_words; base += 32 ) {
+        __m256i column[WORD_SIZE];
+        __m256i match = _mm256_set1_epi8( -1 );
+        for ( int k = 0; k < WORD_SIZE; ++k ) {
+            column[k] = _mm256_load_si256( (const __m256i *)&wc->column[k][base] );
+            __m256i index = _mm256_sub_epi8( column[k], first );
+            __m256i is_high = _mm256_cmpgt_epi8( index, fifteen );
+            __m256i allowed = _mm256_or_si256(
+                _mm256_andnot_si256( is_high, _mm256_shuffle_epi8( low[k], index ) ),
+                _mm256_shuffle_epi8( high[k], _mm256_sub_epi8( index, sixteen ) ) );
+            match = _mm256_and_si256( match, allowed );
+        }
+        for ( int i = 0; i < n_counted; ++i ) {
+            int l = counted[i];
+            __m256i letter = _mm256_set1_epi8( (char)('a' + l) );
+            __m256i n = _mm256_setzero_si256();
+            for ( int k = 0; k < WORD_SIZE; ++k ) {
+                n = _mm256_sub_epi8( n, _mm256_cmpeq_epi8( column[k], letter ) );
             }
-            // candidate letter is not (or no longer) required
-            if ( NULL != strchr( sc->out, word[i] ) ) { // and is no more in
-                return;         // reject, letter can no longer be in word
-            }   // else accept candidate and move on to next letter
+            __m256i rejected = _mm256_or_si256(
+                _mm256_cmpgt_epi8( _mm256_set1_epi8( sc->min_count[l] ), n ),
+                _mm256_cmpgt_epi8( n, _mm256_set1_epi8( sc->max_count[l] ) ) );
+            match = _mm256_andnot_si256( rejected, match );
+        }
+        uint32_t bits = (uint32_t)_mm256_movemask_epi8( match );
+
+        if ( 0 != required ) {
+            uint32_t letter_bits = 0;
+            for ( int j = 0; j < 4; ++j ) {
+                __m256i letters = _mm256_load_si256(
+                                (const __m256i *)&wc->letters[base + 8*j] );
+                __m256i present = _mm256_cmpeq_epi32(
+                        _mm256_and_si256( letters, all_required ), all_required );
+                letter_bits |= (uint32_t)_mm256_movemask_ps(
+                                _mm256_castsi256_ps( present ) ) << (8*j);
+            }
+            bits &= letter_bits;
+        }
+        if ( base + 32 > wc->n_words ) {
+            bits &= ( 1u << (wc->n_words - base) ) - 1;
+        }
+        result->bits[ base / 64 ] |= (uint64_t)bits << ( base % 64 );
+    }
+}
+#endif
+
+extern void get_matching_words_in_columns( const solver_data *given,
+                                           const word_columns *wc,
+                                           word_set *result )
+{
+    assert( result->n_words == wc->n_words );
+#if X86_SIMD
+    if ( __builtin_cpu_supports( "avx2" ) ) {
+        match_columns_avx2( &given->constraint, wc, result );
+        return;
+    }
+#endif
+    clear_word_set( result );
+    char word[WORD_SIZE+1];
+    word[WORD_SIZE] = 0;
+    for ( int i = 0; i < wc->n_words; ++i ) {
+        for ( int k = 0; k < WORD_SIZE; ++k ) {
+            word[k] = wc->column[k][i];
+        }
+        if ( does_word_match( given, word ) ) {
+            add_to_word_set( result, i );
+        }
+    }
+}
+
+/*
+    get_solution_set starts from the whole dictionary and removes words with
+    one set operation per constraint, using the dictionary index:
+    - letters that cannot appear at all: AND NOT words with at least 1 instance,
+    - known letter at a position: AND words with that letter at that position,
+    - other letters not allowed at a position: AND NOT words with that letter
+      at that position,
+    - minimum count: AND words with at least min instances of that letter,
+    - maximum count: AND NOT words with at least max+1 instances.
+    If there are more than MAX_INDEX_OPERATIONS such operations, a single scan
+    of the dictionary columns is faster.
+*/
+static uint32_t get_excluded_letters( const solver_constraint *sc )
+{
+    uint32_t excluded = 0;
+    for ( int l = 0; l < ALPHABET_SIZE; ++l ) {
+        if ( 0 == sc->max_count[l] ) {
+            excluded |= 1u << l;
         }
     }
-    // reject if all required have not been exhausted
-    for ( int i = 0; i < sc->n_required ; i++ ) {
-        if ( required_count[i] != 0 )
+    return excluded;
+}
+
+static int get_index_operation_count( const solver_constraint *sc )
+{
+    uint32_t excluded = get_excluded_letters( sc );
+    int n_operations = __builtin_popcount( excluded );
+    for ( int k = 0; k < WORD_SIZE; ++k ) {
+        uint32_t allowed = sc->allowed[k];
+        if ( 0 == ( allowed & (allowed - 1) ) ) {
+            ++n_operations;
+        } else {
+            n_operations += __builtin_popcount( ~allowed & ~excluded & ALL_LETTERS );
+        }
+    }
+    for ( int i = 0; i < sc->n_counted; ++i ) {
+        int l = sc->counted[i];
+        n_operations += ( sc->min_count[l] > 0 ) + ( sc->max_count[l] < WORD_SIZE );
+    }
+    return n_operations;
+}
+
+extern void get_solution_set( const solver_data *given, word_set *result )
+{
+    const solver_constraint *sc = &given->constraint;
+    if ( get_index_operation_count( sc ) > MAX_INDEX_OPERATIONS ) {
+        get_matching_words_in_columns( given, get_dictionary_columns(), result );
+        return;
+    }
+
+    fill_word_set( result );
+    uint32_t excluded = get_excluded_letters( sc );
+    for ( uint32_t letters = excluded; letters; letters &= letters - 1 ) {
+        and_not_word_set( result, get_letter_count_set( __builtin_ctz( letters ), 1 ) );
+    }
+    for ( int k = 0; k < WORD_SIZE; ++k ) {
+        uint32_t allowed = sc->allowed[k];
+        if ( 0 == allowed ) {           // conflicting constraints
+            clear_word_set( result );
             return;
+        }
+        if ( 0 == ( allowed & (allowed - 1) ) ) {   // single letter
+            and_word_set( result,
+                    get_letter_at_position_set( __builtin_ctz( allowed ), k ) );
+            continue;
+        }
+        uint32_t rejected = ~allowed & ~excluded & ALL_LETTERS;
+        for ( ; rejected; rejected &= rejected - 1 ) {
+            and_not_word_set( result,
+                    get_letter_at_position_set( __builtin_ctz( rejected ), k ) );
+        }
+    }
+    for ( int i = 0; i < sc->n_counted; ++i ) {
+        int l = sc->counted[i];
+        if ( sc->min_count[l] > WORD_SIZE ) {
+            clear_word_set( result );
+            return;
+        }
+        if ( sc->min_count[l] > 0 ) {
+            and_word_set( result, get_letter_count_set( l, sc->min_count[l] ) );
+        }
+        if ( sc->max_count[l] < WORD_SIZE ) {
+            and_not_word_set( result,
+                              get_letter_count_set( l, sc->max_count[l] + 1 ) );
+        }
     }
-    word_node *wn = malloc( sizeof(word_node) );
-    assert( wn );
-    wn->word = word;
-    wn->next = sc->subset;
-    sc->subset = wn;
+}
+
+extern void get_solution_span( const solver_data *given, arena *a,
+                               word_span *result )
+{
+    word_set solutions;
+    init_word_set_in_arena( &solutions, get_dictionary_size(), a );
+    get_solution_set( given, &solutions );
+    get_word_set_span( &solutions, a, result );
 }
 
 extern word_node *get_solutions( solver_data *given )
 {
     //print_solver_data( given );
-    subset_constraints constraints;
-    constraints.subset = NULL;
-    constraints.out = given->out;
-    constraints.known = given->known;
-    constraints.required = given->required;
-    constraints.required_count = given->required_count;
-    constraints.n_required = strlen( constraints.required );
-    memcpy( constraints.wrong, given->wrong, sizeof(char *) * WORD_SIZE );
-    for_each_word_in_dictionary( match, &constraints );
-    return constraints.subset;
+    arena a;
+    init_arena( &a, sizeof( int ) * ( get_dictionary_size() + 64 ) );
+    word_span result;
+    get_solution_span( given, &a, &result );
+    word_node *subset = get_word_list_from_span( &result );
+    discard_arena( &a );
+    return subset;
 }
 
 extern void print_solver_data( solver_data *given )
@@ -102,42 +373,25 @@ extern void print_solver_data( solver_data *given )
 
 extern void init_solver_data( solver_data *data )
 {
-    strcpy( data->known, "-----" );
-    data->out = NULL;
-    memset( data->required, 0, WORD_SIZE+1 );
-    memset( data->required_count, 0, sizeof(int) *(WORD_SIZE+1) );
-    // up to WORD_SIZE wrong characters at up to WORD_SIZE positions
-    char *buffer = malloc( WORD_SIZE * WORD_SIZE );
-    memset( buffer, 0, WORD_SIZE * WORD_SIZE );
-    for ( int i = 0; i < WORD_SIZE; ++i ) {
-        data->wrong[i] = &buffer[WORD_SIZE * i];
-    }
+    // solver data is kept in fixed size arrays, so that setting it from a
+    // data string never allocates
+    reset_solver_data( data );
 }
 
 extern void reset_solver_data( solver_data *data )
 {
     strcpy( data->known, "-----" );
-    if ( NULL != data->out ) {
-        free( data->out );
-        data->out = NULL;
-    }
+    memset( data->out, 0, sizeof( data->out ) );
     memset( data->required, 0, WORD_SIZE+1 );
     memset( data->required_count, 0, sizeof(int) *(WORD_SIZE+1) );
-    memset( data->wrong[0], 0, WORD_SIZE * WORD_SIZE );
+    // up to WORD_SIZE wrong characters at up to WORD_SIZE positions
+    memset( data->wrong, 0, sizeof( data->wrong ) );
+    clear_solver_constraint( &data->constraint );
 }
 
 extern void discard_solver_data( solver_data *data )
 {
-    if ( NULL != data->out ) {
-        free( data->out );
-        data->out = NULL;
-    }
-    if ( NULL != data->wrong ) {
-        free( data->wrong[0] );
-    }
-    for ( int i = 0; i < WORD_SIZE; ++i ) {
-        data->wrong[i] = NULL;
-    }
+    reset_solver_data( data );  // nothing allocated
 }
 
 // no more than 6 sets of 5 letters
@@ -153,19 +407,21 @@ extern solver_data_status set_solver_data( solver_data *given, char *data )
     }
 
     int index_at_pos[WORD_SIZE] = { 0 };
-    given->out = malloc( n_letters + 1 );
-    memset( given->out, 0, n_letters + 1 );
+    memset( given->out, 0, sizeof( given->out ) );
 
     //if ( 0 == strcmp( data, "nsnlnantwenfnenvkewr" ) ) {
     //    printf( "Processing data: nsnlnantwenfnenvkewr\n" );
     //}
+    clear_solver_constraint( &given->constraint );
     for ( int i = 0; i < n; i += (2 * WORD_SIZE) ) {
         solver_data_status status = update_solver_data( given, &data[i], index_at_pos );
         if ( SOLVER_DATA_SET != status ) {
             reset_solver_data( given );
             return status;
         }
+        compile_row( &given->constraint, &data[i] );
     }
+    compile_solver_constraint( &given->constraint );
     return SOLVER_DATA_SET;
 }
 
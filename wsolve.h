@@ -2,13 +2,38 @@
 #ifndef __WSOLVE_H__
 #define __WSOLVE_H__
 
+#include <stdbool.h>
+#include <stdint.h>
+#include "wordle.h"
+#include "wset.h"
+#include "wdict.h"
+
+// compiled form of the solver data, where letters are given as [0-25]. It is
+// built from the same rows of data as known, required, wrong and out, but it
+// is exact in all cases (see set_solver_data in wsolve.c):
+// - allowed[k] is the mask of letters allowed at position k (bit 0 for 'a',
+//   bit 25 for 'z'),
+// - min_count[l] and max_count[l] are the minimum and maximum number of
+//   instances of the letter l in the word,
+// - counted lists the n_counted letters that have a minimum or maximum count
+//   to check, that cannot be expressed by the allowed masks only.
+// If the rows contradict each other, all allowed masks are 0.
+typedef struct {
+    uint32_t allowed[WORD_SIZE];
+    uint8_t  min_count[ALPHABET_SIZE];
+    uint8_t  max_count[ALPHABET_SIZE];
+    uint8_t  counted[ALPHABET_SIZE];
+    int      n_counted;
+} solver_constraint;
+
 typedef struct {
-    char *out;
-    char *wrong[WORD_SIZE];
+    char out[ALPHABET_SIZE+1];              // letters not in word
+    char wrong[WORD_SIZE][WORD_SIZE+1];     // letters at wrong position
     int  required_count[WORD_SIZE+1];   // must have same size as required
     char required[WORD_SIZE+1];
     char known[WORD_SIZE+1];
 
+    solver_constraint constraint;       // compiled by set_solver_data
 } solver_data;
 
 // data is given as an array of sets, each of 5 couples { code, letter }
@@ -45,12 +70,37 @@ typedef enum {
 
 } solver_data_status;
 
+// set_solver_data also compiles the given data into given->constraint
 extern solver_data_status set_solver_data( solver_data *given, char *data );
 extern void print_solver_data( solver_data *given );
 
+// return true if word satisfies the constraint compiled in given.
+extern bool does_word_match( const solver_data *given, const char *word );
+
 extern void reset_solver_data( solver_data *data );
 extern void discard_solver_data( solver_data *data );
 
+// get_solution_set sets in result, which must have been initialized for the
+// dictionary size (see wset.h), the indexes of all words matching the given
+// constraint. With few constraints, each one is a single AND or AND NOT
+// operation on the dictionary index, otherwise get_matching_words_in_columns
+// is called with the dictionary columns.
+extern void get_solution_set( const solver_data *given, word_set *result );
+
+// get_matching_words_in_columns sets in result, which must have been
+// initialized for wc->n_words, the positions in wc of all words matching the
+// given constraint. Words are checked by blocks of 32 with AVX2 instructions
+// if available.
+extern void get_matching_words_in_columns( const solver_data *given,
+                                           const word_columns *wc,
+                                           word_set *result );
+
+// get_solution_span sets result with the indexes of all words matching the
+// given constraint, in increasing order. The span is allocated in the given
+// arena (see warena.h and wset.h).
+extern void get_solution_span( const solver_data *given, arena *a,
+                               word_span *result );
+
 // get_solutions returns a list of word nodes allocated on the heap
 // after use this list must be freed by the caller (free_node_list).
 extern word_node *get_solutions( solver_data *given );
@@ -4,87 +4,307 @@
 #include <stdlib.h>
 #include <string.h>
 #include <assert.h>
+#include <stdint.h>
+#include <stdatomic.h>
 
 #include "wstats.h"
 #include "wdict.h"
 
-typedef struct {
-    // words are listed in an array of array of lists, such that for each
-    // position in a word [0-4] there is a separate array of list of words
-    // containing each possible letter [a-z] at that position:
-    word_node *letter_pos[ALPHABET_SIZE][WORD_SIZE]; // words with letter @ position
-
-    // a separate array keeps the number of words in each list
-    int n_letter_pos[ALPHABET_SIZE][WORD_SIZE];      // n words with letter @ position
-} word_stats;
+// Letter statistics for the whole dictionary are histograms computed in a
+// single pass over the words. The dictionary is cut into chunks processed in
+// the thread pool, each thread adding the words it gets to its own
+// histograms, which are summed at the end.
+#define STATS_CHUNK         256     // words per chunk
+#define N_POSITION_PAIRS    ( WORD_SIZE * ( WORD_SIZE - 1 ) / 2 )
+#define N_TOP_NGRAMS        10      // most frequent ngrams printed
 
-static void init_word_stats( word_stats *ws )
+typedef struct {
+    int n_words;
+    int letter_pos[ALPHABET_SIZE][WORD_SIZE];       // words with letter @ position
+    int repeats[ALPHABET_SIZE][WORD_SIZE+1];        // words with letter n times
+    int repeat_word[ALPHABET_SIZE][WORD_SIZE+1];    // first of them, -1 if none
+    int bigrams[ALPHABET_SIZE*ALPHABET_SIZE];       // consecutive letters
+    int trigrams[ALPHABET_SIZE*ALPHABET_SIZE*ALPHABET_SIZE];
+    // pairs[p][l1*ALPHABET_SIZE+l2]: words with l1 and l2 at position pair p,
+    // with pairs (0,1), (0,2) ... (0,4), (1,2) ... (3,4)
+    int pairs[N_POSITION_PAIRS][ALPHABET_SIZE*ALPHABET_SIZE];
+} letter_stats;
+
+static void init_letter_stats( letter_stats *ls )
 {
-    memset( ws->letter_pos, 0, sizeof( word_node *) * ALPHABET_SIZE * WORD_SIZE );
-    memset( ws->n_letter_pos, 0, sizeof(int) * ALPHABET_SIZE * WORD_SIZE );
+    memset( ls, 0, sizeof( letter_stats ) );
+    memset( ls->repeat_word, -1, sizeof( ls->repeat_word ) );
 }
 
-static void analyze_word( void *ctxt, const char *word )
+static void add_to_letter_stats( void *ctxt, int first, int last, int worker )
 {
-    word_stats *ws = ctxt;
-    for ( int k = 0; k < WORD_SIZE; ++k ) {
-        int j = word[k] - 'a';
-        assert( j < ALPHABET_SIZE );
-        word_node *prev = NULL;
-        for ( word_node *cur = ws->letter_pos[j][k]; cur; prev = cur, cur = cur->next );
-        word_node *node = malloc( sizeof( word_node ) );
-        node->next = NULL;
-        node->word = word;
-        if ( NULL == prev ) {
-            ws->letter_pos[j][k] = node;
-        } else {
-            assert( NULL == prev->next );
-            prev->next = node;
+    letter_stats *ls = &((letter_stats *)ctxt)[worker];
+    for ( int i = first; i < last; ++i ) {
+        const char *word = get_nth_word_in_dictionary( i );
+        int l[WORD_SIZE];
+        int count[ALPHABET_SIZE] = { 0 };
+        for ( int k = 0; k < WORD_SIZE; ++k ) {
+            l[k] = word[k] - 'a';
+            assert( l[k] >= 0 && l[k] < ALPHABET_SIZE );
+            ++ls->letter_pos[l[k]][k];
+            ++count[l[k]];
+        }
+        for ( int j = 0; j < ALPHABET_SIZE; ++j ) {
+            ++ls->repeats[j][count[j]];
+            // chunks may be processed out of order
+            int *rw = &ls->repeat_word[j][count[j]];
+            if ( -1 == *rw || i < *rw ) *rw = i;
         }
-        ++ws->n_letter_pos[j][k];
+        for ( int k = 0, p = 0; k < WORD_SIZE; ++k ) {
+            if ( k + 1 < WORD_SIZE ) {
+                ++ls->bigrams[l[k] * ALPHABET_SIZE + l[k+1]];
+            }
+            if ( k + 2 < WORD_SIZE ) {
+                ++ls->trigrams[( l[k] * ALPHABET_SIZE + l[k+1] ) * ALPHABET_SIZE + l[k+2]];
+            }
+            for ( int m = k + 1; m < WORD_SIZE; ++m, ++p ) {
+                ++ls->pairs[p][l[k] * ALPHABET_SIZE + l[m]];
+            }
+        }
+        ++ls->n_words;
     }
 }
 
-static void discard_word_stats( word_stats *ws )
+static void merge_letter_stats( letter_stats *ls, const letter_stats *other )
 {
-    for ( int k = 0; k < WORD_SIZE; ++k ) {
-        for ( int i = 0; i < ALPHABET_SIZE; ++i ) {
-            word_node *next;
-            for ( word_node *cur = ws->letter_pos[i][k]; cur; cur = next ) {
-                next = cur->next;
-                cur->next = NULL;
-                free( cur );
+    ls->n_words += other->n_words;
+    for ( int j = 0; j < ALPHABET_SIZE; ++j ) {
+        for ( int k = 0; k < WORD_SIZE; ++k ) {
+            ls->letter_pos[j][k] += other->letter_pos[j][k];
+        }
+        for ( int r = 0; r <= WORD_SIZE; ++r ) {
+            ls->repeats[j][r] += other->repeats[j][r];
+            int rw = other->repeat_word[j][r];
+            if ( -1 != rw && ( -1 == ls->repeat_word[j][r] || rw < ls->repeat_word[j][r] ) ) {
+                ls->repeat_word[j][r] = rw;
             }
         }
     }
-    memset( ws->letter_pos, 0, sizeof( word_node *) * ALPHABET_SIZE * WORD_SIZE );
-    memset( ws->n_letter_pos, 0, sizeof(int) * ALPHABET_SIZE * WORD_SIZE );
+    for ( int i = 0; i < ALPHABET_SIZE * ALPHABET_SIZE; ++i ) {
+        ls->bigrams[i] += other->bigrams[i];
+        for ( int p = 0; p < N_POSITION_PAIRS; ++p ) {
+            ls->pairs[p][i] += other->pairs[p][i];
+        }
+    }
+    for ( int i = 0; i < ALPHABET_SIZE * ALPHABET_SIZE * ALPHABET_SIZE; ++i ) {
+        ls->trigrams[i] += other->trigrams[i];
+    }
 }
 
-static void set_word_stats_from_dict( word_stats *ws )
+// set ls with the statistics for the whole dictionary, using the given
+// thread pool (or the calling thread only if tp is NULL).
+static void set_letter_stats_from_dict( letter_stats *ls, thread_pool *tp )
 {
-    init_word_stats( ws );
-    for_each_word_in_dictionary( analyze_word, (void *)ws );
+    int n_workers = get_thread_pool_size( tp );
+    letter_stats *shards = malloc( sizeof( letter_stats ) * n_workers );
+    assert( shards );
+    for ( int w = 0; w < n_workers; ++w ) {
+        init_letter_stats( &shards[w] );
+    }
+    run_in_thread_pool( tp, get_dictionary_size(), STATS_CHUNK,
+                        add_to_letter_stats, shards );
+    *ls = shards[0];
+    for ( int w = 1; w < n_workers; ++w ) {
+        merge_letter_stats( ls, &shards[w] );
+    }
+    free( shards );
+}
+
+// set weights[i] with the weight of the word at index i in dictionary: the
+// sum of the number of words with the same letter at the same position, for
+// each position.
+static void set_word_weights( const letter_stats *ls, int *weights )
+{
+    int n_words = get_dictionary_size();
+    for ( int i = 0; i < n_words; ++i ) {
+        const char *word = get_nth_word_in_dictionary( i );
+        weights[i] = 0;
+        for ( int k = 0; k < WORD_SIZE; ++k ) {
+            weights[i] += ls->letter_pos[word[k]-'a'][k];
+        }
+    }
 }
 
-typedef struct _starting_word {
-    struct _starting_word   *next,      // NULL terminated forward chain
-                            *prev,      // circular backward chain
-                            *follow;    // subsequent words
-    int                     weight;
-    const char              *word;
+// The best starting words are searched as a tree: the first level holds the
+// width words with the highest weight in the dictionary, and the children of
+// each word are the width words with the highest weight among the words that
+// do not share any letter with it or with any of its ancestors, down to the
+// given depth. Each path from the root is a sequence of words to try first.
+//
+// Words are identified by their index in dictionary, and the letters in each
+// word are given as a mask (see wdict.h), so that the candidates for the
+// children of a word are simply the candidates for that word that have no
+// letter in common with it. Only the first levels, which are printed, are
+// kept in memory; the deeper levels are only searched for the best sequence.
+//
+// The first levels are searched by the calling thread, then the subtrees
+// below are searched in parallel in the thread pool, one subtree per item so
+// that threads which are done with small subtrees keep taking new ones. Each
+// thread has its own scratch buffers for the candidates at each level.
+#define FIRST_PARALLEL_LEVEL    2
+
+typedef struct {
+    const char  *word;      // NULL if there were less than width candidates
+    int         weight;
+    bool        follow;     // true if the word has children
 } starting_word;
 
-static void free_starting_words( starting_word *root )
+typedef struct {
+    int         *candidates[MAX_SEARCH_DEPTH];  // candidates at each level
+    int         path[MAX_SEARCH_DEPTH];         // current sequence
+    int         ranks[MAX_SEARCH_DEPTH];        // in the parent's children
+    int         best_path[MAX_SEARCH_DEPTH];    // best complete sequence
+    int         best_ranks[MAX_SEARCH_DEPTH];
+    int         best_length;                    // 0 if none
+    int         best_weight;
+} starting_worker;
+
+typedef struct {
+    int             width, depth;
+    int             n_stored;                   // levels kept in memory
+    starting_word   *levels[MAX_SEARCH_DEPTH];  // width^(level+1) words
+    const uint32_t  *masks;                     // letters in each word
+    int             *weights;                   // weight of each word
+    int             n_words;                    // in dictionary
+    starting_worker *workers;
+} starting_search;
+
+// a sequence is better if its total weight is higher or, for the same total
+// weight, if it comes first in the tree, so that the result does not depend
+// on the order in which subtrees are searched.
+static bool is_better_sequence( int weight, const int *ranks, int length,
+                                int best_weight, const int *best_ranks,
+                                int best_length )
+{
+    if ( 0 == best_length || weight != best_weight ) {
+        return 0 == best_length || weight > best_weight;
+    }
+    for ( int i = 0; i < length && i < best_length; ++i ) {
+        if ( ranks[i] != best_ranks[i] ) return ranks[i] < best_ranks[i];
+    }
+    return false;
+}
+
+static void end_sequence( starting_worker *sw, int length, int weight )
+{
+    if ( is_better_sequence( weight, sw->ranks, length, sw->best_weight,
+                             sw->best_ranks, sw->best_length ) ) {
+        memcpy( sw->best_path, sw->path, sizeof(int) * length );
+        memcpy( sw->best_ranks, sw->ranks, sizeof(int) * length );
+        sw->best_length = length;
+        sw->best_weight = weight;
+    }
+}
+
+// set best with the width candidates of highest weight, the highest first,
+// and return their number. Candidates are visited from the end, so that among
+// words with the same weight the last one in dictionary order comes first.
+static int select_starting_words( const starting_search *ss,
+                                  const int *candidates, int n, int *best )
+{
+    int n_best = 0;
+    for ( int i = n - 1; i >= 0; --i ) {
+        int weight = ss->weights[candidates[i]];
+        if ( n_best == ss->width && weight <= ss->weights[best[n_best-1]] ) {
+            continue;
+        }
+        int j = ( n_best < ss->width ) ? n_best++ : n_best - 1;
+        for ( ; j > 0 && weight > ss->weights[best[j-1]]; --j ) {
+            best[j] = best[j-1];
+        }
+        best[j] = candidates[i];
+    }
+    return n_best;
+}
+
+// search the children at the given level among the n candidates, with
+// children stored from first in that level if it is kept in memory, and
+// search their own children down to stop_level (excluded).
+static void search_starting_words( starting_search *ss, starting_worker *sw,
+                                   const int *candidates, int n, int level,
+                                   int first, int weight, int stop_level )
+{
+    int best[MAX_SEARCH_WIDTH];
+    int n_best = select_starting_words( ss, candidates, n, best );
+
+    for ( int j = 0; j < n_best; ++j ) {
+        int word = best[j];
+        int total = weight + ss->weights[word];
+        starting_word *node = NULL;
+        if ( level < ss->n_stored ) {
+            node = &ss->levels[level][first + j];
+            node->word = get_nth_word_in_dictionary( word );
+            node->weight = ss->weights[word];
+        }
+        sw->path[level] = word;
+        sw->ranks[level] = j;
+
+        if ( level + 1 == ss->depth ) {
+            end_sequence( sw, level + 1, total );
+            continue;
+        }
+        if ( level + 1 == stop_level ) {
+            continue;               // searched later, from the same node
+        }
+        uint32_t mask = ss->masks[word];
+        int *next = sw->candidates[level+1];
+        int n_next = 0;
+        for ( int i = 0; i < n; ++i ) {
+            if ( 0 == ( ss->masks[candidates[i]] & mask ) ) {
+                next[n_next++] = candidates[i];
+            }
+        }
+        if ( 0 == n_next ) {
+            end_sequence( sw, level + 1, total );
+        } else {
+            if ( node ) node->follow = true;
+            search_starting_words( ss, sw, next, n_next, level + 1,
+                                   ( first + j ) * ss->width, total, ss->depth );
+        }
+    }
+}
+
+// search the subtrees below the nodes at level FIRST_PARALLEL_LEVEL - 1
+static void search_starting_subtrees( void *ctxt, int first, int last,
+                                      int worker )
 {
-    while ( root ) {
-        starting_word *next = root->next;
-        free_starting_words( root->follow );
-        root->follow = NULL;
-        root->next = NULL;
-        root->prev = NULL;
-        free( root );
-        root = next;
+    starting_search *ss = ctxt;
+    starting_worker *sw = &ss->workers[worker];
+    const int level = FIRST_PARALLEL_LEVEL;
+
+    for ( int index = first; index < last; ++index ) {
+        starting_word *node = &ss->levels[level-1][index];
+        if ( NULL == node->word ) continue;
+
+        // rebuild the sequence leading to the node from the levels above
+        uint32_t mask = 0;
+        int weight = 0;
+        for ( int l = level - 1, i = index; l >= 0; --l, i /= ss->width ) {
+            const starting_word *sn = &ss->levels[l][i];
+            sw->path[l] = get_word_index( sn->word );
+            sw->ranks[l] = i % ss->width;
+            mask |= ss->masks[sw->path[l]];
+            weight += sn->weight;
+        }
+        int *candidates = sw->candidates[level];
+        int n = 0;
+        for ( int i = 0; i < ss->n_words; ++i ) {
+            if ( 0 == ( ss->masks[i] & mask ) ) {
+                candidates[n++] = i;
+            }
+        }
+        if ( 0 == n ) {
+            end_sequence( sw, level, weight );
+        } else {
+            node->follow = true;
+            search_starting_words( ss, sw, candidates, n, level,
+                                   index * ss->width, weight, ss->depth );
+        }
     }
 }
 
@@ -95,8 +315,8 @@ static void indent( int n )
     }
 }
 
-static void print_starting_words( starting_word *root, int weight,
-                           int depth, int max_depth )
+static void print_starting_words( const starting_search *ss, int first,
+                                  int weight, int depth, int max_depth )
 {
     if ( 0 == depth ) {
         printf( "\nBest starting words:" );
@@ -105,295 +325,594 @@ static void print_starting_words( starting_word *root, int weight,
         return;
     }
 
-    for ( starting_word *sw = root; sw; sw = sw->next ) {
+    for ( int j = 0; j < ss->width; ++j ) {
+        const starting_word *sw = &ss->levels[depth][first + j];
         if ( NULL == sw->word )
             break;
         printf( "\n" );
         indent( depth );
         printf( "  %s (weight %d)", sw->word, sw->weight );
         if ( sw->follow ) {
-            print_starting_words( sw->follow, sw->weight + weight,
-                                  depth + 1, max_depth );
+            print_starting_words( ss, ( first + j ) * ss->width,
+                                  sw->weight + weight, depth + 1, max_depth );
         } else {
             printf( " total weight: %d (sequence complete)", sw->weight + weight );
         }
     }
 }
 
-typedef struct {
-    char *out;
-    int  depth;
-    int  length;
-} starting_context;
-
-static starting_word *get_best_starting_words( starting_context *sc, word_stats *ws )
+static void print_best_starting_words( const letter_stats *ls, thread_pool *tp,
+                                       int width, int depth )
 {
-    word_node *list = get_all_words_in_dict_not_sharing_letters( sc->out );
-
-    if ( NULL == list ) return NULL;
-
-    // for each word compute letter at position count
-    starting_word *root = NULL, *prev = NULL, *last;
-    for ( int i = 0; i < sc->length; ++i ) {
-        starting_word *sw = malloc( sizeof( starting_word ) );
-        assert( sw );
-        sw->weight = 0;
-        sw->word = NULL;
-        sw->follow = NULL;
-        sw->next = root;
-        if ( prev ) {
-            prev->prev = sw;
-        } else {
-            last = sw;
+    assert( width > 0 && width <= MAX_SEARCH_WIDTH );
+    assert( depth > 0 && depth <= MAX_SEARCH_DEPTH );
+
+    starting_search ss;
+    ss.width = width;
+    ss.depth = depth;
+    ss.n_words = get_dictionary_size();
+    ss.masks = get_dictionary_columns()->letters;
+    ss.weights = malloc( sizeof(int) * ss.n_words );
+    assert( ss.weights );
+    set_word_weights( ls, ss.weights );
+
+    ss.n_stored = MAX_SEQUENCE_DEPTH > FIRST_PARALLEL_LEVEL ?
+                            MAX_SEQUENCE_DEPTH : FIRST_PARALLEL_LEVEL;
+    if ( ss.n_stored > depth ) ss.n_stored = depth;
+    size_t n_nodes = 1;
+    for ( int l = 0; l < ss.n_stored; ++l ) {
+        n_nodes *= width;
+        ss.levels[l] = calloc( n_nodes, sizeof( starting_word ) );
+        if ( NULL == ss.levels[l] ) {
+            printf( "wordle: not enough memory to search starting words\n" );
+            exit(1);
         }
-        root = sw;
-        prev = sw;
     }
-    root->prev = last;
 
-    for ( word_node *wn = list; wn; wn = wn->next ) {
-        int weight = 0;
-//        printf( "  %s:", wn->word );
-        for ( int k = 0; k < WORD_SIZE; ++k ) {
-//            printf( " %c=%d", wn->word[k], n_letter_pos[wn->word[k]-'a'][k] );
-            weight += ws->n_letter_pos[wn->word[k]-'a'][k];
-        }
-//        printf( " => weight=%d\n", weight );
-        for ( starting_word *cur = root; cur; cur = cur->next ) {
-            if ( weight > cur->weight ) {
-                // try reuse last in list, insert in front of cur if not the same
-                starting_word *last = root->prev;
-                assert( last->next == NULL );
-                assert( last->prev != NULL );
-
-                if ( cur != last ) {
-                    last->next = cur;           // move above cur
-                    last->prev->next = NULL;    // update forward chain
-
-                    if ( cur != root ) {        // update backward chain
-                        root->prev = last->prev;
-                        last->prev = cur->prev;
-                        cur->prev->next = last;
-                        cur->prev = last;
-                    } else {
-                        root = last;            // no backaward chain change
-                    }
-                }
-
-                assert( root->prev->next == NULL );
-                assert( root->prev->prev != NULL );
-
-                last->weight = weight;
-                last->word = wn->word;
-                break;
-            }
+    int n_workers = get_thread_pool_size( tp );
+    ss.workers = malloc( sizeof( starting_worker ) * n_workers );
+    assert( ss.workers );
+    for ( int w = 0; w < n_workers; ++w ) {
+        starting_worker *sw = &ss.workers[w];
+        sw->best_length = 0;
+        sw->best_weight = 0;
+        for ( int l = 0; l < depth; ++l ) {
+            sw->candidates[l] = malloc( sizeof(int) * ss.n_words );
+            assert( sw->candidates[l] );
         }
     }
 
-    if ( sc->depth > 1 ) {
-        starting_context ncontext;
-        ncontext.depth = sc->depth - 1;
-        ncontext.length = sc->length;
-        ncontext.out = malloc( strlen( sc->out ) + WORD_SIZE + 1 );
-        strcpy( ncontext.out, sc->out );
-//        int n = 0;
-        for ( starting_word *cur = root; cur; cur = cur->next ) {
-            if ( NULL == cur->word ) break;
-            strcpy( &ncontext.out[strlen(sc->out)], cur->word );
+    // the first levels in the calling thread, as worker 0
+    int *all = ss.workers[0].candidates[0];
+    for ( int i = 0; i < ss.n_words; ++i ) {
+        all[i] = i;
+    }
+    search_starting_words( &ss, &ss.workers[0], all, ss.n_words, 0, 0, 0,
+                           FIRST_PARALLEL_LEVEL );
+    if ( depth > FIRST_PARALLEL_LEVEL ) {
+        int n_subtrees = 1;
+        for ( int l = 0; l < FIRST_PARALLEL_LEVEL; ++l ) {
+            n_subtrees *= width;
+        }
+        run_in_thread_pool( tp, n_subtrees, 1, search_starting_subtrees, &ss );
+    }
 
-//            printf( " depth %d word #%d: %s @ weight=%d getting followers (out %s)\n",
-//                      sc->depth, n, cur->word, cur->weight, ncontext.out );
-//            ++n;
+    print_starting_words( &ss, 0, 0, 0, MAX_SEQUENCE_DEPTH );
+    printf("\n");
 
-            cur->follow = get_best_starting_words( &ncontext, ws );
+    starting_worker *best = &ss.workers[0];
+    for ( int w = 1; w < n_workers; ++w ) {
+        starting_worker *sw = &ss.workers[w];
+        if ( is_better_sequence( sw->best_weight, sw->best_ranks,
+                                 sw->best_length, best->best_weight,
+                                 best->best_ranks, best->best_length ) ) {
+            best = sw;
         }
-        free( ncontext.out );
     }
-    free_word_list( list );
-    return root;
+    if ( best->best_length > 0 ) {
+        printf( "\nBest sequence of %d word(s), total weight %d:",
+                best->best_length, best->best_weight );
+        for ( int l = 0; l < best->best_length; ++l ) {
+            printf( " %s", get_nth_word_in_dictionary( best->best_path[l] ) );
+        }
+        printf( "\n" );
+    }
+
+    for ( int w = 0; w < n_workers; ++w ) {
+        for ( int l = 0; l < depth; ++l ) {
+            free( ss.workers[w].candidates[l] );
+        }
+    }
+    free( ss.workers );
+    for ( int l = 0; l < ss.n_stored; ++l ) {
+        free( ss.levels[l] );
+    }
+    free( ss.weights );
 }
 
-extern const char *select_most_likely_word( word_node *list )
+// Word sets are searched exhaustively: all sets of size words with no letter
+// in common are enumerated, and the count sets with the highest total weight
+// are kept. Words are sorted by decreasing weight, and each word is given the
+// list of the words after it in that order that have no letter in common with
+// it, computed once for all words. A set is extended only with the words
+// after its last word in its first word's list that have no letter in common
+// with any word in the set, which are filtered level by level. Since the
+// candidates at each level are sorted by decreasing weight, the sum of the
+// weights of the next candidates is an upper bound of the weight of any set
+// still to be found at that level: as soon as that bound is below the weight
+// of the count-th best set, no better set can be found at that level.
+//
+// The sets starting with each word are searched in parallel in the thread
+// pool. Each thread keeps its own best sets in a bounded heap, and the lowest
+// weight of the best sets in any full heap is shared as the pruning limit.
+
+typedef struct {
+    int         weight;
+    int         positions[MAX_SEARCH_DEPTH];    // in sorted order, increasing
+} letter_set;
+
+// a bounded heap of the best sets, the worst of them at the root
+typedef struct {
+    letter_set  *sets;
+    int         n, k;
+} letter_set_heap;
+
+typedef struct {
+    int             size;           // words in a set
+    int             n_words;
+    int             *order;         // dictionary indexes by decreasing weight
+    int             *weights;       // in sorted order
+    uint32_t        *masks;         // in sorted order
+    int             *compatible;    // lists of compatible words
+    size_t          *first;         // first[p]: start of the list of p
+    int             *n_compatible;  // n_compatible[p]: length of the list of p
+    int             **candidates;   // per worker and level
+    letter_set      *current;       // per worker
+    letter_set_heap *heaps;         // per worker
+    atomic_int      limit;          // lowest weight in a full heap
+} letter_set_search;
+
+// a set is better if its weight is higher or, for the same weight, if its
+// words come first in sorted order.
+static inline bool is_better_letter_set( const letter_set *a, const letter_set *b, int size )
 {
-    word_stats ws;
-    init_word_stats( &ws );
-    int n = 0;
-    for ( word_node *wn = list; wn; wn = wn->next ) {
-        analyze_word( &ws, wn->word );
-        ++n;
+    if ( a->weight != b->weight ) return a->weight > b->weight;
+    for ( int i = 0; i < size; ++i ) {
+        if ( a->positions[i] != b->positions[i] ) {
+            return a->positions[i] < b->positions[i];
+        }
     }
-    const char *best = NULL;
-    if ( n > 2 ) {  // otherwise no choice or equal probability
-        // for each word compute letter at position count
-        int max_weight = 0;
+    return false;
+}
 
-        for ( word_node *wn = list; wn; wn = wn->next ) {
+static void push_letter_set( letter_set_heap *h, const letter_set *ls, int size )
+{
+    if ( h->n < h->k ) {
+        int i = h->n++;
+        while ( i > 0 && is_better_letter_set( &h->sets[(i-1)/2], ls, size ) ) {
+            h->sets[i] = h->sets[(i-1)/2];
+            i = (i-1)/2;
+        }
+        h->sets[i] = *ls;
+    } else if ( is_better_letter_set( ls, &h->sets[0], size ) ) {
+        h->sets[0] = *ls;
+        int i = 0;
+        while ( true ) {
+            int worst = i, l = 2 * i + 1, r = l + 1;
+            if ( l < h->n && is_better_letter_set( &h->sets[worst], &h->sets[l], size ) ) worst = l;
+            if ( r < h->n && is_better_letter_set( &h->sets[worst], &h->sets[r], size ) ) worst = r;
+            if ( worst == i )
+                break;
+            letter_set tmp = h->sets[i];
+            h->sets[i] = h->sets[worst];
+            h->sets[worst] = tmp;
+            i = worst;
+        }
+    }
+}
+
+static void add_letter_set( letter_set_search *lss, int worker )
+{
+    letter_set_heap *heap = &lss->heaps[worker];
+    push_letter_set( heap, &lss->current[worker], lss->size );
+    if ( heap->n == heap->k ) {
+        int weight = heap->sets[0].weight;
+        int limit = atomic_load_explicit( &lss->limit, memory_order_relaxed );
+        while ( weight > limit &&
+                ! atomic_compare_exchange_weak_explicit( &lss->limit, &limit,
+                        weight, memory_order_relaxed, memory_order_relaxed ) );
+    }
+}
 
-            int weight = 0;
-    //        printf( "  %s:", wn->word );
-            for ( int k = 0; k < WORD_SIZE; ++k ) {
-    //            printf( " %c=%d", wn->word[k], n_letter_pos[wn->word[k]-'a'][k] );
-                weight += ws.n_letter_pos[wn->word[k]-'a'][k];
+// the highest possible weight of a set made of the given weight and the
+// weights of the first n candidates
+static inline int get_set_bound( const letter_set_search *lss, int weight,
+                                 const int *candidates, int n )
+{
+    for ( int i = 0; i < n; ++i ) {
+        weight += lss->weights[candidates[i]];
+    }
+    return weight;
+}
+
+// extend the current set, which has level words, with the n candidates
+static void extend_letter_set( letter_set_search *lss, int worker, int level,
+                               const int *candidates, int n, int weight )
+{
+    letter_set *current = &lss->current[worker];
+    int left = lss->size - level;       // words still to add
+    for ( int i = 0; i + left <= n; ++i ) {
+        int limit = atomic_load_explicit( &lss->limit, memory_order_relaxed );
+        if ( get_set_bound( lss, weight, &candidates[i], left ) < limit ) {
+            break;
+        }
+        int p = candidates[i];
+        current->positions[level] = p;
+        if ( 1 == left ) {
+            current->weight = weight + lss->weights[p];
+            add_letter_set( lss, worker );
+            continue;
+        }
+        uint32_t mask = lss->masks[p];
+        int *next = &lss->candidates[worker][(size_t)( level + 1 ) * lss->n_words];
+        int n_next = 0;
+        for ( int j = i + 1; j < n; ++j ) {
+            if ( 0 == ( lss->masks[candidates[j]] & mask ) ) {
+                next[n_next++] = candidates[j];
             }
-    //        printf( " => weight=%d\n", weight );
-            if ( weight > max_weight ) {
-                max_weight = weight;
-                best = wn->word;
+        }
+        extend_letter_set( lss, worker, level + 1, next, n_next,
+                           weight + lss->weights[p] );
+    }
+}
+
+// count the compatible words of the words in [first, last) if the lists are
+// not allocated yet, or fill their lists otherwise
+static void set_compatible_words( void *ctxt, int first, int last, int worker )
+{
+    (void)worker;
+    letter_set_search *lss = ctxt;
+    for ( int p = first; p < last; ++p ) {
+        uint32_t mask = lss->masks[p];
+        int *list = ( NULL == lss->compatible ) ? NULL :
+                                            &lss->compatible[lss->first[p]];
+        int n = 0;
+        for ( int q = p + 1; q < lss->n_words; ++q ) {
+            if ( 0 == ( lss->masks[q] & mask ) ) {
+                if ( list ) list[n] = q;
+                ++n;
             }
         }
-//        printf( "Best: %s @ weight %d\n", best, max_weight );
+        lss->n_compatible[p] = n;
     }
-    discard_word_stats( &ws );
-    return best;
 }
 
-typedef struct {
-    int pos_sorted_letter[ALPHABET_SIZE][WORD_SIZE];
-    int pos_sorted_count[ALPHABET_SIZE][WORD_SIZE];
-    int global_n[ ALPHABET_SIZE ];
-} letter_rank;
+// search the sets starting with the words in [first, last)
+static void search_letter_sets( void *ctxt, int first, int last, int worker )
+{
+    letter_set_search *lss = ctxt;
+    for ( int p = first; p < last; ++p ) {
+        lss->current[worker].positions[0] = p;
+        if ( 1 == lss->size ) {
+            int limit = atomic_load_explicit( &lss->limit, memory_order_relaxed );
+            if ( lss->weights[p] < limit ) break;
+            lss->current[worker].weight = lss->weights[p];
+            add_letter_set( lss, worker );
+        } else {
+            extend_letter_set( lss, worker, 1, &lss->compatible[lss->first[p]],
+                               lss->n_compatible[p], lss->weights[p] );
+        }
+    }
+}
 
-// this assumes that word_stats is already populated
-static void sort_letter_pos( word_stats *wsp, letter_rank *lr )
+// sort by decreasing weight, the last word in dictionary order first among
+// words of equal weight, as for the best starting words
+static const int *s_sort_weights;
+
+static int compare_word_weights( const void *a, const void *b )
 {
-    memset( lr->pos_sorted_letter, 0, sizeof(int) * ALPHABET_SIZE * WORD_SIZE );
-    memset( lr->pos_sorted_count, 0, sizeof(int) * ALPHABET_SIZE * WORD_SIZE );
-    memset( lr->global_n, 0, sizeof(int) * ALPHABET_SIZE );
-
-    for ( int k = 0; k < WORD_SIZE; ++k ) { // for each position
-        int rank = 0;
-        int letter_n[ALPHABET_SIZE] = { 0 }; 
-        for ( int j = 0; j < ALPHABET_SIZE; ++j ) { // for each letter @pos
-            letter_n[j] = wsp->n_letter_pos[j][k];  // n words with letter @pos
-        }
-        while ( true ) {                            // sort by frequency
-            int highest_n = 0;
-            int highest_l = 0;                      // inefficient n^2
-            for ( int j = 0; j < ALPHABET_SIZE; ++j ) {
-                if ( highest_n < letter_n[j] ) {
-                    highest_n = letter_n[j];
-                    highest_l = j;
-                }
-            }
-            if ( 0 == highest_n ) {
-                break;
-            }
-//            printf( "  %c: %.2f%%\n", 'a'+ highest_l,
-//                               (double)(highest_n*100)/(double)n_words );
+    int ia = *(const int *)a, ib = *(const int *)b;
+    if ( s_sort_weights[ia] != s_sort_weights[ib] ) {
+        return ( s_sort_weights[ia] > s_sort_weights[ib] ) ? -1 : 1;
+    }
+    return ( ia > ib ) ? -1 : ( ia < ib );
+}
 
-            lr->pos_sorted_letter[rank][k] = 'a' + highest_l;
-            lr->pos_sorted_count[rank++][k] = highest_n;
-            lr->global_n[ highest_l ] += highest_n;
+static int compare_letter_sets( const void *a, const void *b )
+{
+    const letter_set *sa = a, *sb = b;
+    if ( is_better_letter_set( sa, sb, MAX_SEARCH_DEPTH ) ) return -1;
+    return is_better_letter_set( sb, sa, MAX_SEARCH_DEPTH );
+}
 
-            letter_n[highest_l] = 0;    // remove from list
+extern void print_word_sets( thread_pool *tp, int size, int count )
+{
+    assert( size > 0 && size <= MAX_SEARCH_DEPTH );
+    assert( count > 0 && count <= MAX_WORD_SETS );
+
+    letter_stats stats;
+    set_letter_stats_from_dict( &stats, tp );
+
+    letter_set_search lss;
+    lss.size = size;
+    lss.n_words = get_dictionary_size();
+    int *weights = malloc( sizeof(int) * lss.n_words );
+    lss.order = malloc( sizeof(int) * lss.n_words );
+    lss.weights = malloc( sizeof(int) * lss.n_words );
+    lss.masks = malloc( sizeof(uint32_t) * lss.n_words );
+    lss.first = malloc( sizeof(size_t) * ( lss.n_words + 1 ) );
+    lss.n_compatible = malloc( sizeof(int) * lss.n_words );
+    assert( weights && lss.order && lss.weights && lss.masks && lss.first &&
+            lss.n_compatible );
+
+    set_word_weights( &stats, weights );
+    for ( int i = 0; i < lss.n_words; ++i ) {
+        lss.order[i] = i;
+    }
+    s_sort_weights = weights;
+    qsort( lss.order, lss.n_words, sizeof(int), compare_word_weights );
+    const uint32_t *letters = get_dictionary_columns()->letters;
+    for ( int p = 0; p < lss.n_words; ++p ) {
+        lss.weights[p] = weights[lss.order[p]];
+        lss.masks[p] = letters[lss.order[p]];
+    }
+    free( weights );
+
+    // compatible words are counted first, then stored in a single array
+    lss.compatible = NULL;
+    if ( size > 1 ) {
+        run_in_thread_pool( tp, lss.n_words, 64, set_compatible_words, &lss );
+        lss.first[0] = 0;
+        for ( int p = 0; p < lss.n_words; ++p ) {
+            lss.first[p+1] = lss.first[p] + lss.n_compatible[p];
+        }
+        lss.compatible = malloc( sizeof(int) * ( lss.first[lss.n_words] + 1 ) );
+        if ( NULL == lss.compatible ) {
+            printf( "wordle: not enough memory to search word sets\n" );
+            exit(1);
         }
+        run_in_thread_pool( tp, lss.n_words, 64, set_compatible_words, &lss );
     }
-}
 
-typedef struct  {
-    const char *word;
-    int  n_letters;
-    int  count;
-} repeat;
+    int n_workers = get_thread_pool_size( tp );
+    lss.candidates = malloc( sizeof(int *) * n_workers );
+    lss.current = calloc( n_workers, sizeof(letter_set) );
+    lss.heaps = malloc( sizeof(letter_set_heap) * n_workers );
+    letter_set *sets = calloc( (size_t)n_workers * count, sizeof(letter_set) );
+    assert( lss.candidates && lss.current && lss.heaps && sets );
+    for ( int w = 0; w < n_workers; ++w ) {
+        lss.candidates[w] = malloc( sizeof(int) * size * lss.n_words );
+        assert( lss.candidates[w] );
+        lss.heaps[w].sets = &sets[w * count];
+        lss.heaps[w].n = 0;
+        lss.heaps[w].k = count;
+    }
+    atomic_init( &lss.limit, 0 );
 
-typedef struct {
-    repeat max_repeats[ALPHABET_SIZE];
-    int    index;
-} repeat_stats;
+    run_in_thread_pool( tp, lss.n_words, 1, search_letter_sets, &lss );
+
+    // heaps are merged in place, since they are contiguous
+    int n_sets = 0;
+    for ( int w = 0; w < n_workers; ++w ) {
+        for ( int i = 0; i < lss.heaps[w].n; ++i ) {
+            sets[n_sets++] = lss.heaps[w].sets[i];
+        }
+    }
+    qsort( sets, n_sets, sizeof(letter_set), compare_letter_sets );
+    if ( n_sets > count ) n_sets = count;
+
+    printf( "Best sets of %d word(s) without common letters:\n", size );
+    for ( int i = 0; i < n_sets; ++i ) {
+        printf( " %4d %6d ", i + 1, sets[i].weight );
+        for ( int l = 0; l < size; ++l ) {
+            printf( " %s", get_nth_word_in_dictionary( lss.order[sets[i].positions[l]] ) );
+        }
+        printf( "\n" );
+    }
+    if ( 0 == n_sets ) {
+        printf( " none\n" );
+    }
+
+    for ( int w = 0; w < n_workers; ++w ) {
+        free( lss.candidates[w] );
+    }
+    free( sets );
+    free( lss.heaps );
+    free( lss.current );
+    free( lss.candidates );
+    free( lss.compatible );
+    free( lss.n_compatible );
+    free( lss.first );
+    free( lss.masks );
+    free( lss.weights );
+    free( lss.order );
+}
+
+// The most likely word is selected with a histogram of the candidates
+// holding letter at position, in a flat array on the stack: each candidate
+// is weighted by the sum of the counts for its letters at their positions.
+// Letters are read from the dictionary columns (see wdict.h), so that
+// nothing is allocated.
+#define HISTOGRAM_SIZE  ( WORD_SIZE * ALPHABET_SIZE )   // [position][letter]
 
-static void update_repeat( void *ctxt, const char *word )
+static inline int get_histogram_weight( const int *counts,
+                                        const word_columns *wc, int index )
 {
-    repeat_stats *rs = ctxt;
+    int weight = 0;
+    for ( int k = 0; k < WORD_SIZE; ++k ) {
+        weight += counts[k * ALPHABET_SIZE + wc->column[k][index] - 'a'];
+    }
+    return weight;
+}
 
-    int r = 0;
+extern const char *select_most_likely_word_in_span( const word_span *span )
+{
+    if ( span->n_words <= 2 ) {     // no choice or equal probability
+        return NULL;
+    }
+    const word_columns *wc = get_dictionary_columns();
+    int counts[HISTOGRAM_SIZE] = { 0 };
     for ( int k = 0; k < WORD_SIZE; ++k ) {
-        if ( word[k] == 'a' + rs->index ) {
-            ++r;
+        const char *column = wc->column[k];
+        int *count = &counts[k * ALPHABET_SIZE];
+        for ( int i = 0; i < span->n_words; ++i ) {
+            ++count[column[span->indexes[i]] - 'a'];
         }
     }
-    if ( rs->max_repeats[rs->index].n_letters < r ) {
-        rs->max_repeats[rs->index].n_letters = r;
-        rs->max_repeats[rs->index].count = 1;
-        rs->max_repeats[rs->index].word = word;
-    } else if ( rs->max_repeats[rs->index].n_letters == r ) {
-        ++rs->max_repeats[rs->index].count;
+
+    // the last word in the span wins among words of equal weight
+    int max_weight = 0, best = 0;
+    for ( int i = 0; i < span->n_words; ++i ) {
+        int weight = get_histogram_weight( counts, wc, span->indexes[i] );
+        if ( weight >= max_weight ) {
+            max_weight = weight;
+            best = span->indexes[i];
+        }
     }
+    return get_nth_word_in_dictionary( best );
 }
 
-extern void print_letter_stats( void )
+extern const char *select_most_likely_word( word_node *list )
 {
-    word_stats stats, *wsp = &stats;
-    set_word_stats_from_dict( wsp );
-
-    letter_rank lr;
-    int n_words = get_dictionary_size();
-    printf( "%d words in dictionary\n", n_words );
+    size_t n = get_word_count( list );
+    arena a;
+    init_arena( &a, sizeof( int ) * ( n + 1 ) );
+    word_span span;
+    span.indexes = arena_alloc( &a, sizeof( int ) * n );
+    span.n_words = 0;
+    for ( word_node *wn = list; wn; wn = wn->next ) {
+        span.indexes[span.n_words++] = get_word_index( wn->word );
+    }
+    // the span is reversed, so that the first word in the list wins among
+    // words of equal weight
+    for ( int i = 0, j = span.n_words - 1; i < j; ++i, --j ) {
+        int index = span.indexes[i];
+        span.indexes[i] = span.indexes[j];
+        span.indexes[j] = index;
+    }
+    const char *best = select_most_likely_word_in_span( &span );
+    discard_arena( &a );
+    return best;
+}
 
-    sort_letter_pos( wsp, &lr );
+// ranking of histogram entries by decreasing count, then increasing key
+static const int *s_rank_counts;
 
-    for ( int k = 0; k < WORD_SIZE; ++k ) {
-        printf( "Frequency of letters appearing in position %d:\n", k );
-        for ( int rank = 0; rank < ALPHABET_SIZE; ++rank ) {
-            if ( lr.pos_sorted_letter[rank][k] == 0 )
-                break;
+static int compare_counts( const void *a, const void *b )
+{
+    int ka = *(const int *)a, kb = *(const int *)b;
+    if ( s_rank_counts[ka] != s_rank_counts[kb] ) {
+        return ( s_rank_counts[ka] > s_rank_counts[kb] ) ? -1 : 1;
+    }
+    return ( ka > kb ) - ( ka < kb );
+}
 
-            int highest_n = lr.pos_sorted_count[rank][k];
-            printf( "  %c: %.2f%%\n", lr.pos_sorted_letter[rank][k],
-                             (double)(highest_n*100)/(double)n_words );
-        }
-        printf( "\n" );
+// set keys with the keys [0, n) of the non-zero counts, the highest count
+// first, and return their number.
+static int rank_counts( const int *counts, int n, int *keys )
+{
+    int n_keys = 0;
+    for ( int i = 0; i < n; ++i ) {
+        if ( 0 != counts[i] ) keys[n_keys++] = i;
     }
+    s_rank_counts = counts;
+    qsort( keys, n_keys, sizeof(int), compare_counts );
+    return n_keys;
+}
 
-    printf( "Global frequencies:\n" );
+static int sum_counts( const int *counts, int n )
+{
     int total = 0;
-    for ( int i = 0; i < ALPHABET_SIZE; ++i ) {
-        total += lr.global_n[i];
+    for ( int i = 0; i < n; ++i ) {
+        total += counts[i];
+    }
+    return total;
+}
+
+// print the N_TOP_NGRAMS most frequent ngrams of length n
+static void print_ngrams( const int *counts, int n )
+{
+    int n_counts = 1;
+    for ( int i = 0; i < n; ++i ) {
+        n_counts *= ALPHABET_SIZE;
     }
-//    double check = 0;
-    while ( true ) {
-        int highest_n = 0;
-        int highest_l = 0;
+    int *keys = malloc( sizeof(int) * n_counts );
+    assert( keys );
+    int total = sum_counts( counts, n_counts );
+    int n_keys = rank_counts( counts, n_counts, keys );
+    for ( int i = 0; i < n_keys && i < N_TOP_NGRAMS; ++i ) {
+        char ngram[4];
+        for ( int j = n - 1, key = keys[i]; j >= 0; --j, key /= ALPHABET_SIZE ) {
+            ngram[j] = 'a' + key % ALPHABET_SIZE;
+        }
+        ngram[n] = 0;
+        printf( "  %s: %.2f%%\n", ngram,
+                (double)(counts[keys[i]]*100) / (double)total );
+    }
+}
+
+extern void print_letter_stats( thread_pool *tp, int width, int depth )
+{
+    letter_stats stats;
+    set_letter_stats_from_dict( &stats, tp );
+
+    int n_words = stats.n_words;
+    printf( "%d words in dictionary\n", n_words );
+
+    int keys[ALPHABET_SIZE*ALPHABET_SIZE];
+    int counts[ALPHABET_SIZE];
+    int global_n[ALPHABET_SIZE] = { 0 };
+    for ( int k = 0; k < WORD_SIZE; ++k ) {
+        printf( "Frequency of letters appearing in position %d:\n", k );
         for ( int j = 0; j < ALPHABET_SIZE; ++j ) {
-            if ( highest_n < lr.global_n[j] ) {
-                highest_n = lr.global_n[j];
-                highest_l = j;
-            }
+            counts[j] = stats.letter_pos[j][k];
+            global_n[j] += counts[j];
         }
-        if ( 0 == highest_n ) {
-            break;
+        int n_keys = rank_counts( counts, ALPHABET_SIZE, keys );
+        for ( int rank = 0; rank < n_keys; ++rank ) {
+            printf( "  %c: %.2f%%\n", 'a' + keys[rank],
+                    (double)(counts[keys[rank]]*100)/(double)n_words );
         }
-        printf( "  %c: %.2f%%\n", 'a'+ highest_l,
-                             (double)(highest_n*100) / (double)total );
-//        check += (double)highest_n / (double)total;
-        lr.global_n[highest_l] = 0;
+        printf( "\n" );
     }
-//    printf( "\nChecking frequency sums: %f\n", check );
 
-    repeat_stats rs;
-    memset( rs.max_repeats, 0, sizeof(repeat) * ALPHABET_SIZE );
-
-    for ( rs.index = 0; rs.index < ALPHABET_SIZE; ++rs.index ) {
-        for_each_word_in_dictionary( update_repeat, &rs );
+    printf( "Global frequencies:\n" );
+    int total = sum_counts( global_n, ALPHABET_SIZE );
+    int n_keys = rank_counts( global_n, ALPHABET_SIZE, keys );
+    for ( int rank = 0; rank < n_keys; ++rank ) {
+        printf( "  %c: %.2f%%\n", 'a' + keys[rank],
+                (double)(global_n[keys[rank]]*100) / (double)total );
     }
+
     printf( "\nMax repeats:\n");
     for ( int i = 0; i < ALPHABET_SIZE; ++i ) {
-        if ( rs.max_repeats[i].n_letters > 1 ) {
+        int r = WORD_SIZE;
+        while ( r > 0 && 0 == stats.repeats[i][r] ) --r;
+        if ( r > 1 ) {
             printf( " letter %c appears %d times in %d word(s) (e.g. %s)\n",
-                    'a' + i, rs.max_repeats[i].n_letters,
-                    rs.max_repeats[i].count, rs.max_repeats[i].word );
+                    'a' + i, r, stats.repeats[i][r],
+                    get_nth_word_in_dictionary( stats.repeat_word[i][r] ) );
         }
     }
 
-    starting_context sc;
-    sc.out = "";
-    sc.depth = MAX_SEARCH_DEPTH;
-    sc.length = MAX_SEARCH_WIDTH;
-
-    starting_word *root = get_best_starting_words( &sc, wsp );
-    print_starting_words( root, 0, 0, MAX_SEQUENCE_DEPTH );
-    printf("\n");
+    printf( "\nMost frequent bigrams:\n" );
+    print_ngrams( stats.bigrams, 2 );
+    printf( "\nMost frequent trigrams:\n" );
+    print_ngrams( stats.trigrams, 3 );
+
+    printf( "\nMost frequent letter pairs at given positions:\n" );
+    for ( int k = 0, p = 0; k < WORD_SIZE; ++k ) {
+        for ( int m = k + 1; m < WORD_SIZE; ++m, ++p ) {
+            n_keys = rank_counts( stats.pairs[p], ALPHABET_SIZE * ALPHABET_SIZE, keys );
+            printf( "  positions %d,%d:", k, m );
+            for ( int i = 0; i < n_keys && i < N_TOP_NGRAMS / 2; ++i ) {
+                printf( " %c%c %.2f%%", 'a' + keys[i] / ALPHABET_SIZE,
+                        'a' + keys[i] % ALPHABET_SIZE,
+                        (double)(stats.pairs[p][keys[i]]*100)/(double)n_words );
+            }
+            printf( "\n" );
+        }
+    }
 
-    free_starting_words( root );
-    discard_word_stats( wsp );
+    print_best_starting_words( &stats, tp, width, depth );
 }
-
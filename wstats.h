@@ -1,9 +1,25 @@
 
 #include "wordle.h"
+#include "wset.h"
+#include "wpool.h"
 
-// printout letter statistics from the wordle dictionary
-// dictionary must be loaded before...
-extern void print_letter_stats( );
+// printout letter, bigram, trigram and positional pair statistics from the
+// wordle dictionary, computed in a single pass over the dictionary split
+// between the threads in the pool, followed by the best sequences of
+// starting words not sharing any letter, searched with the given width
+// (number of words selected at each step) and depth (number of words in a
+// sequence) using the given thread pool (or the calling thread only if tp
+// is NULL). Width must be in [1-MAX_SEARCH_WIDTH] and depth in
+// [1-MAX_SEARCH_DEPTH]. The dictionary must be loaded before...
+extern void print_letter_stats( thread_pool *tp, int width, int depth );
+
+// print the count sets of size words not sharing any letter with the highest
+// total weight, where the weight of a word is the sum of the number of words
+// in dictionary with the same letter at the same position. All sets are
+// considered, using the given thread pool (or the calling thread only if tp
+// is NULL). Size must be in [1-MAX_SEARCH_DEPTH] and count in
+// [1-MAX_WORD_SETS]. The dictionary must be loaded before.
+extern void print_word_sets( thread_pool *tp, int size, int count );
 
 // given a list of words, calculate letter statistics and select the
 // "most likely" word in the list, that is the word where letters have
@@ -16,3 +32,8 @@ extern void print_letter_stats( );
 // The returned string points into the given word list. It is up to the
 // caller to free the list after use.
 extern const char *select_most_likely_word( word_node *list );
+
+// same as select_most_likely_word, for the words in a span (see wset.h).
+// The last word in the span is returned among words of equal probability.
+// Nothing is allocated.
+extern const char *select_most_likely_word_in_span( const word_span *span );
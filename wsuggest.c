@@ -0,0 +1,410 @@
+
+#include <stdio.h>
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdatomic.h>
+#include <math.h>
+#include <time.h>
+#include <assert.h>
+
+#include "wdict.h"
+#include "wpos.h"
+#include "wmatrix.h"
+#include "wstats.h"
+#include "wsuggest.h"
+
+/*
+    For a guess splitting n candidates into buckets of c[p] candidates for
+    each feedback pattern p, the entropy is:
+        H = - sum( c[p]/n * log2( c[p]/n ) ) = log2( n ) - sum( c[p] * log2( c[p] ) ) / n
+    so that maximizing H is the same as minimizing S = sum( c[p] * log2( c[p] ) ),
+    which is computed with a table of c * log2( c ) for c in [0, n].
+
+    Other strategies minimize the largest bucket (minimax) or the expected
+    bucket size sum( c[p] * c[p] ) / n (expected). Since both can only grow as
+    candidates are added to buckets, a guess is dropped as soon as its partial
+    score is worse than the k-th best score found so far (branch and bound).
+
+    Guesses are all words in dictionary, candidates first, and they are scored
+    by chunks in the thread pool. Each thread keeps its own k best guesses in
+    a bounded heap, and the k best of all threads are selected at the end, so
+    that only n_threads * k scores are ever sorted. Patterns are read from the
+    full feedback matrix if available, otherwise they are computed for all
+    candidates at once with get_patterns_from_columns. Every SUGGEST_CHUNK
+    guesses, the deadline is checked and remaining guesses are skipped if it
+    has passed (the pool may give all guesses in a single range when it runs
+    in the calling thread only, or is busy with another request), in
+    which case the suggestions are marked as exhausted for the calling thread.
+*/
+
+#define SUGGEST_CHUNK   16      // guesses per chunk
+#define PRUNE_BLOCK     256     // candidates between pruning checks
+#define SCORE_EPSILON   1e-9    // S values closer than that are equal
+
+static thread_pool  *s_pool;
+static int          s_budget;   // ms
+
+static _Thread_local bool   t_exhausted;    // by the last get_suggestions
+
+typedef struct {
+    double  sum;            // S
+    int64_t squares;        // sum( c[p] * c[p] )
+    int     worst;          // max( c[p] )
+    int     position;       // in guesses
+} guess_score;
+
+// a bounded heap of the k best scores, the worst of them at the root
+typedef struct {
+    guess_score         *scores;
+    int                 n, k;
+    suggest_strategy    strategy;
+} score_heap;
+
+typedef struct {
+    const word_span     *candidates;
+    suggest_strategy    strategy;
+    int                 *guesses;       // candidates first
+    int                 n_guesses;
+    const double        *xlogx;         // xlogx[c] = c * log2( c )
+    word_columns        columns;        // candidates, if no full matrix
+    uint8_t             *patterns;      // n_workers * candidates->n_words
+    score_heap          *heaps;         // n_workers
+    atomic_int_fast64_t limit;          // best primary score so far if k is 1
+    struct timespec     deadline;
+    atomic_bool         stop;
+    atomic_int          last;           // no guess after it can be better
+    atomic_bool         exhausted;      // deadline passed before the end
+} suggest_ctxt;
+
+static const char *s_strategy_names[] = {
+    "entropy", "minimax", "expected", "positional"
+};
+
+extern bool get_strategy_from_name( const char *name, suggest_strategy *strategy )
+{
+    for ( int i = ENTROPY_STRATEGY; i <= POSITIONAL_STRATEGY; ++i ) {
+        if ( 0 == strcmp( name, s_strategy_names[i] ) ) {
+            *strategy = (suggest_strategy)i;
+            return true;
+        }
+    }
+    return false;
+}
+
+extern const char *get_strategy_name( suggest_strategy strategy )
+{
+    return s_strategy_names[strategy];
+}
+
+// the primary score is compared first, then the secondary score and finally
+// the position (candidates first, then in dictionary order):
+// - ENTROPY_STRATEGY: lower S, lower position
+// - MINIMAX_STRATEGY: lower worst, lower squares, lower position
+// - EXPECTED_STRATEGY: lower squares, lower worst, lower position
+static inline bool is_better( const guess_score *a, const guess_score *b,
+                              suggest_strategy strategy )
+{
+    switch ( strategy ) {
+    case MINIMAX_STRATEGY:
+        if ( a->worst != b->worst ) return a->worst < b->worst;
+        if ( a->squares != b->squares ) return a->squares < b->squares;
+        break;
+    case EXPECTED_STRATEGY:
+        if ( a->squares != b->squares ) return a->squares < b->squares;
+        if ( a->worst != b->worst ) return a->worst < b->worst;
+        break;
+    default:
+        if ( a->sum < b->sum - SCORE_EPSILON ) return true;
+        if ( a->sum > b->sum + SCORE_EPSILON ) return false;
+        break;
+    }
+    return a->position < b->position;
+}
+
+// the primary score for strategies that can prune
+static inline int64_t get_primary_score( const guess_score *gs,
+                                         suggest_strategy strategy )
+{
+    return ( MINIMAX_STRATEGY == strategy ) ? gs->worst : gs->squares;
+}
+
+static void sift_down( score_heap *h, int i )
+{
+    while ( true ) {
+        int worst = i, l = 2 * i + 1, r = l + 1;
+        if ( l < h->n && is_better( &h->scores[worst], &h->scores[l], h->strategy ) ) worst = l;
+        if ( r < h->n && is_better( &h->scores[worst], &h->scores[r], h->strategy ) ) worst = r;
+        if ( worst == i )
+            break;
+        guess_score tmp = h->scores[i];
+        h->scores[i] = h->scores[worst];
+        h->scores[worst] = tmp;
+        i = worst;
+    }
+}
+
+static void push_score( score_heap *h, const guess_score *gs )
+{
+    if ( h->n < h->k ) {
+        int i = h->n++;
+        while ( i > 0 && is_better( &h->scores[(i-1)/2], gs, h->strategy ) ) {
+            h->scores[i] = h->scores[(i-1)/2];
+            i = (i-1)/2;
+        }
+        h->scores[i] = *gs;
+    } else if ( is_better( gs, &h->scores[0], h->strategy ) ) {
+        h->scores[0] = *gs;
+        sift_down( h, 0 );
+    }
+}
+
+static bool is_past( const struct timespec *deadline )
+{
+    struct timespec now;
+    clock_gettime( CLOCK_MONOTONIC, &now );
+    return now.tv_sec > deadline->tv_sec ||
+           ( now.tv_sec == deadline->tv_sec && now.tv_nsec >= deadline->tv_nsec );
+}
+
+// score the guess at position, by blocks of PRUNE_BLOCK candidates. With the
+// minimax and expected strategies, return false as soon as the partial
+// primary score is above limit: the guess cannot be better than the guesses
+// already found, whatever the remaining candidates.
+static bool score_guess( suggest_ctxt *sc, int position, uint8_t *patterns,
+                         int64_t limit, guess_score *gs )
+{
+    int n = sc->candidates->n_words;
+    const int *indexes = sc->candidates->indexes;
+    int guess = sc->guesses[position];
+    const uint8_t *row = get_feedback_row( guess );
+    const char *word = get_nth_word_in_dictionary( guess );
+
+    int counts[N_PATTERNS] = { 0 };
+    int worst = 0;
+    int64_t squares = 0;
+    for ( int base = 0; base < n; base += PRUNE_BLOCK ) {
+        int end = ( base + PRUNE_BLOCK < n ) ? base + PRUNE_BLOCK : n;
+        if ( NULL == row ) {
+            word_columns block = sc->columns;   // aligned since PRUNE_BLOCK is
+            for ( int k = 0; k < WORD_SIZE; ++k ) {
+                block.column[k] += base;
+            }
+            block.letters += base;
+            block.n_words = end - base;
+            get_patterns_from_columns( &block, word, &patterns[base] );
+        }
+        for ( int i = base; i < end; ++i ) {
+            int c = ++counts[ ( NULL == row ) ? patterns[i] : row[ indexes[i] ] ];
+            squares += 2 * c - 1;
+            if ( c > worst ) worst = c;
+        }
+        if ( ( MINIMAX_STRATEGY == sc->strategy && worst > limit ) ||
+             ( EXPECTED_STRATEGY == sc->strategy && squares > limit ) ) {
+            return false;
+        }
+    }
+
+    gs->sum = 0.0;
+    for ( int p = 0; p < N_PATTERNS; ++p ) {
+        gs->sum += sc->xlogx[ counts[p] ];
+    }
+    gs->squares = squares;
+    gs->worst = worst;
+    gs->position = position;
+    return true;
+}
+
+static bool must_stop( suggest_ctxt *sc )
+{
+    if ( atomic_load_explicit( &sc->stop, memory_order_relaxed ) ) {
+        return true;
+    }
+    if ( 0 != s_budget && is_past( &sc->deadline ) ) {
+        atomic_store_explicit( &sc->exhausted, true, memory_order_relaxed );
+        atomic_store_explicit( &sc->stop, true, memory_order_relaxed );
+        return true;
+    }
+    return false;
+}
+
+static void score_guesses( void *ctxt, int first, int last, int worker )
+{
+    suggest_ctxt *sc = ctxt;
+    uint8_t *patterns = ( NULL == sc->patterns ) ? NULL :
+                        &sc->patterns[ (size_t)worker * sc->candidates->n_words ];
+    score_heap *heap = &sc->heaps[worker];
+    for ( int position = first; position < last; ++position ) {
+        if ( 0 == ( position - first ) % SUGGEST_CHUNK && must_stop( sc ) ) {
+            return;
+        }
+        if ( position > atomic_load_explicit( &sc->last, memory_order_relaxed ) ) {
+            return;
+        }
+        // a guess that is not in the k best of its own thread cannot be in
+        // the k best of all threads. With k = 1, the best of all threads so
+        // far is shared.
+        int64_t limit = INT64_MAX;
+        if ( 1 == heap->k ) {
+            limit = atomic_load_explicit( &sc->limit, memory_order_relaxed );
+        } else if ( heap->n == heap->k ) {
+            limit = get_primary_score( &heap->scores[0], sc->strategy );
+        }
+
+        guess_score gs;
+        if ( ! score_guess( sc, position, patterns, limit, &gs ) ) {
+            continue;
+        }
+        push_score( heap, &gs );
+
+        if ( 1 == heap->k ) {
+            int64_t primary = get_primary_score( &gs, sc->strategy );
+            int64_t current = atomic_load_explicit( &sc->limit, memory_order_relaxed );
+            while ( primary < current &&
+                    ! atomic_compare_exchange_weak_explicit( &sc->limit, &current,
+                            primary, memory_order_relaxed, memory_order_relaxed ) );
+
+            // a candidate giving one pattern per candidate cannot be beaten,
+            // but it ties with other such guesses at lower positions, which
+            // are still scored so that the result does not depend on threads
+            if ( 1 == gs.worst && position < sc->candidates->n_words ) {
+                int last = atomic_load_explicit( &sc->last, memory_order_relaxed );
+                while ( position < last &&
+                        ! atomic_compare_exchange_weak_explicit( &sc->last, &last,
+                                position, memory_order_relaxed, memory_order_relaxed ) );
+                return;
+            }
+        }
+    }
+}
+
+static void set_suggestion( const suggest_ctxt *sc, const guess_score *gs,
+                            suggestion *s )
+{
+    int n = sc->candidates->n_words;
+    s->word = get_nth_word_in_dictionary( sc->guesses[gs->position] );
+    s->entropy = log2( n ) - gs->sum / n;
+    s->expected = (double)gs->squares / n;
+    s->worst = gs->worst;
+}
+
+extern void init_suggestions( thread_pool *tp, int budget )
+{
+    s_pool = tp;
+    s_budget = budget;
+}
+
+extern int get_suggestions( const word_span *candidates,
+                            suggest_strategy strategy, int k, arena *a,
+                            suggestion *best )
+{
+    t_exhausted = false;
+    int n = candidates->n_words;
+    if ( n <= 2 || k <= 0 ) {
+        return 0;
+    }
+
+    suggest_ctxt sc;
+    clock_gettime( CLOCK_MONOTONIC, &sc.deadline );
+    sc.deadline.tv_sec += s_budget / 1000;
+    sc.deadline.tv_nsec += (long)( s_budget % 1000 ) * 1000000;
+    if ( sc.deadline.tv_nsec >= 1000000000 ) {
+        ++sc.deadline.tv_sec;
+        sc.deadline.tv_nsec -= 1000000000;
+    }
+    atomic_init( &sc.stop, false );
+    atomic_init( &sc.last, INT32_MAX );
+    atomic_init( &sc.exhausted, false );
+    atomic_init( &sc.limit, INT64_MAX );
+    sc.candidates = candidates;
+    sc.strategy = strategy;
+
+    int n_dict = get_dictionary_size();
+    sc.guesses = arena_alloc( a, sizeof( int ) * n_dict );
+    bool *is_candidate = arena_alloc( a, sizeof( bool ) * n_dict );
+    memset( is_candidate, 0, sizeof( bool ) * n_dict );
+    sc.n_guesses = 0;
+    for ( int i = 0; i < n; ++i ) {
+        sc.guesses[sc.n_guesses++] = candidates->indexes[i];
+        is_candidate[ candidates->indexes[i] ] = true;
+    }
+    for ( int i = 0; i < n_dict; ++i ) {
+        if ( ! is_candidate[i] ) {
+            sc.guesses[sc.n_guesses++] = i;
+        }
+    }
+    if ( k > sc.n_guesses ) {
+        k = sc.n_guesses;
+    }
+
+    double *xlogx = arena_alloc( a, sizeof( double ) * ( n + 1 ) );
+    xlogx[0] = 0.0;
+    for ( int c = 1; c <= n; ++c ) {
+        xlogx[c] = c * log2( c );
+    }
+    sc.xlogx = xlogx;
+
+    int n_workers = get_thread_pool_size( s_pool );
+    sc.heaps = arena_alloc( a, sizeof( score_heap ) * n_workers );
+    guess_score *scores = arena_alloc( a, sizeof( guess_score ) * n_workers * k );
+    for ( int w = 0; w < n_workers; ++w ) {
+        sc.heaps[w].scores = &scores[w * k];
+        sc.heaps[w].n = 0;
+        sc.heaps[w].k = k;
+        sc.heaps[w].strategy = strategy;
+    }
+    bool full = ( FULL_MATRIX == get_feedback_matrix_type() );
+    sc.patterns = NULL;
+    if ( ! full ) {
+        init_word_columns_in_arena( &sc.columns, n, a );
+        set_word_columns( &sc.columns, candidates->indexes, n );
+        sc.patterns = arena_alloc( a, (size_t)n_workers * n );
+    }
+
+    if ( POSITIONAL_STRATEGY != strategy ) {
+        run_in_thread_pool( s_pool, sc.n_guesses, SUGGEST_CHUNK, score_guesses, &sc );
+        t_exhausted = atomic_load_explicit( &sc.exhausted, memory_order_relaxed );
+    }
+
+    // merge all heaps: at most n_workers * k scores to sort by insertion
+    int n_scores = 0;
+    for ( int w = 0; w < n_workers; ++w ) {
+        for ( int i = 0; i < sc.heaps[w].n; ++i ) {
+            guess_score gs = sc.heaps[w].scores[i];
+            int j = n_scores++;
+            for ( ; j > 0 && is_better( &gs, &scores[j-1], strategy ); --j ) {
+                scores[j] = scores[j-1];
+            }
+            scores[j] = gs;
+        }
+    }
+
+    int n_best = ( n_scores < k ) ? n_scores : k;
+    for ( int i = 0; i < n_best; ++i ) {
+        set_suggestion( &sc, &scores[i], &best[i] );
+    }
+    if ( 0 == n_best ) {    // positional, or budget exhausted before scoring
+        sc.guesses[0] = get_word_index( select_most_likely_word_in_span( candidates ) );
+        sc.strategy = POSITIONAL_STRATEGY;      // no pruning
+        guess_score gs;
+        score_guess( &sc, 0, sc.patterns, INT64_MAX, &gs );
+        set_suggestion( &sc, &gs, &best[0] );
+        n_best = 1;
+    }
+    return n_best;
+}
+
+extern bool is_suggestion_budget_exhausted( void )
+{
+    return t_exhausted;
+}
+
+extern const char *get_suggestion( const word_span *candidates, arena *a )
+{
+    suggestion best;
+    if ( 0 == get_suggestions( candidates, ENTROPY_STRATEGY, 1, a, &best ) ) {
+        return NULL;
+    }
+    return best.word;
+}
@@ -0,0 +1,67 @@
+
+#ifndef __WSUGGEST_H__
+#define __WSUGGEST_H__
+
+#include <stdbool.h>
+#include "wordle.h"
+#include "wset.h"
+#include "wpool.h"
+
+// The suggestion engine selects the next word to try given the candidates
+// left, as the word with the highest entropy: trying a word splits the
+// candidates according to the feedback pattern each candidate would give,
+// and the entropy measures how much information that feedback is expected
+// to give on average. Any word in the dictionary can be suggested, even if
+// it is not a candidate, but candidates are preferred when they give the
+// same entropy, since they can also win.
+
+// The strategy selects how words are compared:
+typedef enum {
+    ENTROPY_STRATEGY,       // highest entropy (the default)
+    MINIMAX_STRATEGY,       // smallest number of candidates left in the worst case
+    EXPECTED_STRATEGY,      // smallest expected number of candidates left
+    POSITIONAL_STRATEGY     // select_most_likely_word_in_span (see wstats.h)
+} suggest_strategy;
+
+// convert a strategy name ("entropy", "minimax", "expected" or "positional")
+// into a suggest_strategy. Return false if the name is not recognized.
+extern bool get_strategy_from_name( const char *name, suggest_strategy *strategy );
+
+// return the name of a strategy
+extern const char *get_strategy_name( suggest_strategy strategy );
+
+// initialize the suggestion engine, using the given thread pool (or the
+// calling thread only if tp is NULL) to score guesses in parallel. If budget
+// is not 0, scoring stops after budget milliseconds and the best word found
+// so far is returned. Candidates are always scored first.
+extern void init_suggestions( thread_pool *tp, int budget );
+
+// a suggested word with its scores for the current candidates
+typedef struct {
+    const char  *word;
+    double      entropy;        // in bits
+    double      expected;       // number of candidates left on average
+    int         worst;          // largest number of candidates left
+} suggestion;
+
+// set best with the k best words to try for the given candidates according
+// to the given strategy, the best first, and return the number of words in
+// best: at most k, or 0 if there are less than 3 candidates. With the
+// positional strategy, or if no word could be scored within the budget, a
+// single word is returned, selected with select_most_likely_word_in_span
+// (see wstats.h). Temporary data is allocated in the given arena.
+extern int get_suggestions( const word_span *candidates,
+                            suggest_strategy strategy, int k, arena *a,
+                            suggestion *best );
+
+// return true if the last call to get_suggestions in the calling thread
+// stopped at the budget before scoring all words, so that its suggestions
+// may differ from the suggestions given without a budget.
+extern bool is_suggestion_budget_exhausted( void );
+
+// return the suggested word for the given candidates, or NULL if there are
+// less than 3 candidates (no choice or equal probability). This is the first
+// word returned by get_suggestions with the entropy strategy and k = 1.
+extern const char *get_suggestion( const word_span *candidates, arena *a );
+
+#endif /* __WSUGGEST_H__ */
@@ -0,0 +1,805 @@
+
+#include <stdio.h>
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+#include <limits.h>
+#include <stdatomic.h>
+#include <pthread.h>
+#include <assert.h>
+#include <unistd.h>
+
+#include "wdict.h"
+#include "wpos.h"
+#include "wmatrix.h"
+#include "wtree.h"
+
+/*
+    The cost of a tree is the total number of tries needed to find each word
+    in the dictionary. For a set S of n words, with d tries left, trying the
+    word g splits S into buckets S[p], one per feedback pattern p, so that:
+        cost( S, d ) = min over g of: n + sum( cost( S[p], d-1 ) ) for p != WIN
+    since each word in S needs the try with g, and only the word g, if it is
+    in S, is found with that try. The cost is infinite (NO_TREE) if some word
+    cannot be found in d tries.
+
+    The search is a depth first branch and bound: a set of n words cannot cost
+    less than 2n - 1 tries (1 for a word found immediately, and at least 2 for
+    the other ones), so that a guess cannot cost less than n plus the sum of
+    the lower bounds of its buckets. Guesses are tried in increasing order of
+    that lower bound, and a guess is abandoned as soon as the cost of its
+    first buckets plus the lower bound of the remaining ones reaches the best
+    cost found so far (beta), which is passed down to the buckets.
+
+    The cost of a set of words at a given depth is kept in a memo table shared
+    by all threads, either as an exact cost with the best guess, or as a lower
+    bound if the search was abandoned. The same sets appear in many branches,
+    since different guesses often give the same buckets. The memo table is a
+    hash table of MEMO_BUCKETS chains protected by MEMO_LOCKS mutexes, and it
+    stops growing when it reaches MAX_TREE_MEMORY MB.
+
+    The first guesses are searched in parallel, one per thread at a time,
+    sharing the best cost found so far. Each time a first guess is done, its
+    cost (exact if it is the best so far, or a lower bound) is appended to the
+    checkpoint file, so that an interrupted search can skip those first guesses
+    when it resumes. The memo table is not saved: it is rebuilt as needed.
+
+    Finally, the tree is rebuilt from the best first guess, asking the search
+    for the best guess of each bucket, which is found in the memo table most
+    of the time, and written in the tree file:
+        - header: the dictionary checksum, the number of nodes and edges,
+        - nodes: the guess and the edges of each node, the root first,
+        - edges: the pattern and the child node of each edge, the edges of
+          a node being contiguous and in increasing pattern order.
+    Looking up the next word is a walk from the root, with a binary search
+    in the edges of each node.
+*/
+
+#define NO_TREE             (INT_MAX / 4)
+#define MEMO_BUCKETS        (1 << 20)       // must be a power of 2
+#define MEMO_LOCKS          64              // must be a power of 2
+#define MIN_MEMO_SIZE       3               // smaller sets are solved at once
+#define CHECKPOINT_HEADER   "wordle-tree"
+#define CHECKPOINT_LINE     64
+
+#define TREE_FILE_MAGIC     "WORDTREE"
+#define TREE_FILE_VERSION   1
+#define TREE_BYTE_ORDER     0x01020304
+
+typedef struct _memo_entry {
+    struct _memo_entry *next;           // in the same bucket
+    uint64_t    hash;
+    int         n_words, depth;
+    int         cost;                   // exact, or a lower bound
+    int         guess;                  // best guess, if cost is exact
+    bool        exact;
+    int         indexes[];              // n_words
+} memo_entry;
+
+static memo_entry       **t_memo;
+static pthread_mutex_t  t_memo_locks[MEMO_LOCKS];
+static atomic_size_t    t_memo_memory;
+
+typedef struct {
+    uint32_t    guess;                  // index in dictionary
+    uint32_t    first_edge;
+    uint32_t    n_edges;
+} tree_node;
+
+typedef struct {
+    uint32_t    pattern;
+    uint32_t    child;                  // index in nodes
+} tree_edge;
+
+typedef struct {
+    char        magic[8];               // TREE_FILE_MAGIC, without terminating 0
+    uint32_t    version;                // TREE_FILE_VERSION
+    uint32_t    byte_order;             // TREE_BYTE_ORDER
+    uint32_t    n_words;                // in dictionary
+    uint32_t    n_nodes, n_edges;
+    uint32_t    cost;                   // total number of tries
+    uint64_t    dictionary;             // dictionary checksum
+} tree_file_header;
+
+static uint8_t          *t_tree;        // loaded tree file
+static const tree_node  *t_nodes;
+static const tree_edge  *t_edges;
+
+// a guess with its lower bound, as key = 2 * bound + 1 if the guess is not
+// in the words to find, so that candidates come first for the same bound.
+typedef struct {
+    int     key;
+    int     guess;
+} ranked_guess;
+
+// scratch data for one depth in one thread
+typedef struct {
+    ranked_guess    *ranked;            // all guesses
+    int             *buckets;           // all words
+    uint8_t         *patterns;          // all words
+} search_level;
+
+typedef struct {
+    search_level    level[MAX_TRIES+1];
+} search_worker;
+
+typedef struct {
+    int             n_words;            // in dictionary
+    int             *words;             // all words in dictionary
+    search_worker   *workers;
+    ranked_guess    *ranked;            // first guesses
+    int             n_ranked;
+    bool            *done;              // first guesses found in checkpoint
+    int             n_done;
+    atomic_int      best;               // best cost so far
+    int             best_guess;
+    pthread_mutex_t lock;               // best_guess, n_done and checkpoint
+    FILE            *checkpoint;
+} tree_search;
+
+static inline int get_lower_bound( int n, int depth )
+{
+    if ( 0 == n ) return 0;
+    if ( 0 == depth || ( n > 1 && 1 == depth ) ) return NO_TREE;
+    return 2 * n - 1;
+}
+
+static inline uint8_t get_pattern( const uint8_t *row, int guess, int word )
+{
+    return ( NULL != row ) ? row[word] : get_feedback( guess, word );
+}
+
+static uint64_t get_memo_hash( const int *words, int n, int depth )
+{
+    uint64_t hash = 14695981039346656037u;      // FNV-1a
+    hash = ( hash ^ (uint64_t)depth ) * 1099511628211u;
+    for ( int i = 0; i < n; ++i ) {
+        hash = ( hash ^ (uint64_t)words[i] ) * 1099511628211u;
+    }
+    return hash;
+}
+
+static inline memo_entry **get_memo_bucket( uint64_t hash )
+{
+    return &t_memo[ hash & ( MEMO_BUCKETS - 1 ) ];
+}
+
+static inline pthread_mutex_t *get_memo_lock( uint64_t hash )
+{
+    return &t_memo_locks[ hash & ( MEMO_LOCKS - 1 ) ];
+}
+
+// must be called with the memo lock held
+static memo_entry *find_memo_entry( uint64_t hash, const int *words, int n,
+                                    int depth )
+{
+    for ( memo_entry *e = *get_memo_bucket( hash ); e; e = e->next ) {
+        if ( e->hash == hash && e->n_words == n && e->depth == depth &&
+             0 == memcmp( e->indexes, words, sizeof( int ) * n ) ) {
+            return e;
+        }
+    }
+    return NULL;
+}
+
+static bool get_memo( uint64_t hash, const int *words, int n, int depth,
+                      int *cost, int *guess, bool *exact )
+{
+    pthread_mutex_lock( get_memo_lock( hash ) );
+    memo_entry *e = find_memo_entry( hash, words, n, depth );
+    if ( NULL != e ) {
+        *cost = e->cost;
+        *guess = e->guess;
+        *exact = e->exact;
+    }
+    pthread_mutex_unlock( get_memo_lock( hash ) );
+    return NULL != e;
+}
+
+static void set_memo( uint64_t hash, const int *words, int n, int depth,
+                      int cost, int guess, bool exact )
+{
+    pthread_mutex_lock( get_memo_lock( hash ) );
+    memo_entry *e = find_memo_entry( hash, words, n, depth );
+    if ( NULL != e ) {      // keep the best information
+        if ( exact || ( ! e->exact && cost > e->cost ) ) {
+            e->cost = cost;
+            e->guess = guess;
+            e->exact = exact;
+        }
+    } else {
+        size_t size = sizeof( memo_entry ) + sizeof( int ) * n;
+        if ( atomic_load_explicit( &t_memo_memory, memory_order_relaxed ) + size <=
+                                        (size_t)MAX_TREE_MEMORY * 1024 * 1024 ) {
+            e = malloc( size );
+            assert( e );
+            e->hash = hash;
+            e->n_words = n;
+            e->depth = depth;
+            e->cost = cost;
+            e->guess = guess;
+            e->exact = exact;
+            memcpy( e->indexes, words, sizeof( int ) * n );
+            memo_entry **bucket = get_memo_bucket( hash );
+            e->next = *bucket;
+            *bucket = e;
+            atomic_fetch_add_explicit( &t_memo_memory, size, memory_order_relaxed );
+        }
+    }
+    pthread_mutex_unlock( get_memo_lock( hash ) );
+}
+
+static void init_memo( void )
+{
+    t_memo = calloc( MEMO_BUCKETS, sizeof( memo_entry * ) );
+    assert( t_memo );
+    for ( int i = 0; i < MEMO_LOCKS; ++i ) {
+        pthread_mutex_init( &t_memo_locks[i], NULL );
+    }
+    atomic_init( &t_memo_memory, 0 );
+}
+
+static void discard_memo( void )
+{
+    for ( int i = 0; i < MEMO_BUCKETS; ++i ) {
+        memo_entry *e = t_memo[i];
+        while ( e ) {
+            memo_entry *next = e->next;
+            free( e );
+            e = next;
+        }
+    }
+    free( t_memo );
+    t_memo = NULL;
+    for ( int i = 0; i < MEMO_LOCKS; ++i ) {
+        pthread_mutex_destroy( &t_memo_locks[i] );
+    }
+}
+
+static int compare_ranked_guesses( const void *a, const void *b )
+{
+    const ranked_guess *ra = a, *rb = b;
+    if ( ra->key != rb->key ) return ( ra->key < rb->key ) ? -1 : 1;
+    return ( ra->guess < rb->guess ) ? -1 : ( ra->guess > rb->guess );
+}
+
+// set ranked with the guesses that can find all n words in depth tries with
+// a lower bound less than beta, in increasing order of lower bound, and
+// return their number. Guesses that do not split the words are ignored.
+static int rank_guesses( int n_guesses, const int *words, int n, int depth,
+                         int beta, ranked_guess *ranked )
+{
+    int counts[N_PATTERNS] = { 0 };
+    uint8_t used[N_PATTERNS];
+    int n_ranked = 0;
+    for ( int g = 0; g < n_guesses; ++g ) {
+        const uint8_t *row = get_feedback_row( g );
+        int n_used = 0;
+        for ( int i = 0; i < n; ++i ) {
+            uint8_t p = get_pattern( row, g, words[i] );
+            if ( 0 == counts[p]++ ) {
+                used[n_used++] = p;
+            }
+        }
+
+        bool useful = ( 1 != n_used || 0 != counts[WINNING_PATTERN] );
+        int bound = n;
+        for ( int u = 0; u < n_used; ++u ) {
+            uint8_t p = used[u];
+            if ( WINNING_PATTERN != p && bound < NO_TREE ) {
+                int b = get_lower_bound( counts[p], depth - 1 );
+                bound = ( NO_TREE == b ) ? NO_TREE : bound + b;
+            }
+        }
+        bool candidate = ( 0 != counts[WINNING_PATTERN] );
+        for ( int u = 0; u < n_used; ++u ) {
+            counts[ used[u] ] = 0;
+        }
+        if ( useful && bound < beta && bound < NO_TREE ) {
+            ranked[n_ranked].key = 2 * bound + ( candidate ? 0 : 1 );
+            ranked[n_ranked].guess = g;
+            ++n_ranked;
+        }
+    }
+    qsort( ranked, n_ranked, sizeof( ranked_guess ), compare_ranked_guesses );
+    return n_ranked;
+}
+
+// split the n words into buckets according to the pattern given by guess:
+// the words giving pattern p are in buckets[start[p]] to buckets[start[p+1]-1]
+// in the same order as in words.
+static void split_words( int guess, const int *words, int n, uint8_t *patterns,
+                         int *buckets, int start[N_PATTERNS+1] )
+{
+    const uint8_t *row = get_feedback_row( guess );
+    int counts[N_PATTERNS] = { 0 };
+    for ( int i = 0; i < n; ++i ) {
+        patterns[i] = get_pattern( row, guess, words[i] );
+        ++counts[ patterns[i] ];
+    }
+    start[0] = 0;
+    for ( int p = 0; p < N_PATTERNS; ++p ) {
+        start[p+1] = start[p] + counts[p];
+        counts[p] = start[p];
+    }
+    for ( int i = 0; i < n; ++i ) {
+        buckets[ counts[ patterns[i] ]++ ] = words[i];
+    }
+}
+
+static int search_words( search_worker *sw, const int *words, int n, int depth,
+                         int beta, int *guess );
+
+// add the cost of each bucket other than the winning one to cost, which
+// already includes the lower bound of all buckets, as long as it stays less
+// than *best, which can be lowered concurrently if shared is true.
+static int add_bucket_costs( search_worker *sw, search_level *sl, int depth,
+                             const int start[N_PATTERNS+1], int cost,
+                             const atomic_int *shared, int best )
+{
+    for ( int p = 0; p < WINNING_PATTERN; ++p ) {
+        if ( NULL != shared ) {
+            best = atomic_load_explicit( shared, memory_order_relaxed );
+        }
+        if ( cost >= best ) {
+            break;
+        }
+        int c = start[p+1] - start[p];
+        if ( c <= 2 ) {     // the lower bound is exact
+            continue;
+        }
+        int bound = get_lower_bound( c, depth - 1 );
+        cost += search_words( sw, &sl->buckets[start[p]], c, depth - 1,
+                              best - cost + bound, NULL ) - bound;
+    }
+    return cost;
+}
+
+// return the cost of the n words with depth tries left, or a lower bound of
+// that cost not less than beta if it is not less than beta. If guess is not
+// NULL and the cost is less than beta, it is set to the best guess.
+static int search_words( search_worker *sw, const int *words, int n, int depth,
+                         int beta, int *guess )
+{
+    int bound = get_lower_bound( n, depth );
+    if ( n <= 2 || bound >= beta ) {
+        if ( NULL != guess && 0 != n ) {
+            *guess = words[0];
+        }
+        return bound;
+    }
+
+    uint64_t hash = 0;
+    if ( n >= MIN_MEMO_SIZE ) {
+        int cost, best_guess;
+        bool exact;
+        hash = get_memo_hash( words, n, depth );
+        if ( get_memo( hash, words, n, depth, &cost, &best_guess, &exact ) ) {
+            if ( exact ) {
+                if ( NULL != guess && cost < beta ) {
+                    *guess = best_guess;
+                }
+                return cost;
+            }
+            if ( cost >= beta ) {
+                return cost;
+            }
+        }
+    }
+
+    search_level *sl = &sw->level[depth];
+    int n_ranked = rank_guesses( get_dictionary_size(), words, n, depth,
+                                 beta, sl->ranked );
+    int best = beta, best_guess = -1;
+    int start[N_PATTERNS+1];
+    for ( int r = 0; r < n_ranked && sl->ranked[r].key / 2 < best; ++r ) {
+        int g = sl->ranked[r].guess;
+        split_words( g, words, n, sl->patterns, sl->buckets, start );
+        int cost = add_bucket_costs( sw, sl, depth, start,
+                                     sl->ranked[r].key / 2, NULL, best );
+        if ( cost < best ) {
+            best = cost;
+            best_guess = g;
+        }
+    }
+
+    if ( n >= MIN_MEMO_SIZE ) {
+        set_memo( hash, words, n, depth, best, best_guess, -1 != best_guess );
+    }
+    if ( NULL != guess && -1 != best_guess ) {
+        *guess = best_guess;
+    }
+    return best;
+}
+
+static void record_first_guess( tree_search *ts, int r, int cost )
+{
+    int g = ts->ranked[r].guess;
+    pthread_mutex_lock( &ts->lock );
+    // a cost less than the best so far is exact (see add_bucket_costs)
+    bool exact = cost < atomic_load( &ts->best );
+    if ( exact ) {
+        atomic_store( &ts->best, cost );
+        ts->best_guess = g;
+    }
+    ++ts->n_done;
+    fprintf( ts->checkpoint, "%s %d %c\n", get_nth_word_in_dictionary( g ),
+             cost, exact ? 'e' : 'b' );
+    fflush( ts->checkpoint );
+    if ( exact ) {
+        printf( "Best so far: %s, %d tries for %d words (%.4f average) [%d/%d]\n",
+                get_nth_word_in_dictionary( g ), cost, ts->n_words,
+                (double)cost / ts->n_words, ts->n_done, ts->n_ranked );
+    } else if ( 0 == ts->n_done % 100 ) {
+        printf( "%d/%d first words checked\n", ts->n_done, ts->n_ranked );
+    }
+    pthread_mutex_unlock( &ts->lock );
+}
+
+static void search_first_guesses( void *ctxt, int first, int last, int worker )
+{
+    tree_search *ts = ctxt;
+    search_worker *sw = &ts->workers[worker];
+    search_level *sl = &sw->level[MAX_TRIES];
+    int start[N_PATTERNS+1];
+    for ( int r = first; r < last; ++r ) {
+        if ( ts->done[r] ) {
+            continue;
+        }
+        int cost = ts->ranked[r].key / 2;
+        if ( cost < atomic_load( &ts->best ) ) {
+            split_words( ts->ranked[r].guess, ts->words, ts->n_words,
+                         sl->patterns, sl->buckets, start );
+            cost = add_bucket_costs( sw, sl, MAX_TRIES, start, cost,
+                                     &ts->best, 0 );
+        }
+        record_first_guess( ts, r, cost );
+    }
+}
+
+// read the first guesses already done from the checkpoint file if it exists,
+// then rewrite it with only the complete lines, to append the next ones. The
+// new file is written next to the old one and renamed over it once it is on
+// disk, so that the progress saved is never lost if the search is killed.
+static void open_checkpoint( tree_search *ts, const char *path )
+{
+    uint64_t checksum = get_dictionary_checksum();
+    int *position = malloc( sizeof( int ) * ts->n_words );
+    int *costs = malloc( sizeof( int ) * ( ts->n_ranked + 1 ) );
+    assert( position && costs );
+    for ( int g = 0; g < ts->n_words; ++g ) {
+        position[g] = -1;
+    }
+    for ( int r = 0; r < ts->n_ranked; ++r ) {
+        position[ ts->ranked[r].guess ] = r;
+    }
+
+    FILE *f = fopen( path, "r" );
+    if ( NULL != f ) {
+        char line[CHECKPOINT_LINE];
+        unsigned int n_words, n_tries;
+        unsigned long long file_checksum;
+        if ( NULL == fgets( line, CHECKPOINT_LINE, f ) ||
+             3 != sscanf( line, CHECKPOINT_HEADER " %u %llx %u",
+                          &n_words, &file_checksum, &n_tries ) ||
+             n_words != (unsigned int)ts->n_words ||
+             file_checksum != checksum || n_tries != MAX_TRIES ) {
+            printf( "wordle: checkpoint file %s does not match the dictionary\n", path );
+            exit(1);
+        }
+        while ( NULL != fgets( line, CHECKPOINT_LINE, f ) &&
+                NULL != strchr( line, '\n' ) ) {
+            char word[WORD_SIZE+1];
+            int cost;
+            char kind;
+            if ( 3 != sscanf( line, "%5s %d %c", word, &cost, &kind ) ) {
+                break;
+            }
+            int g = get_word_index( word );
+            if ( -1 == g || -1 == position[g] || ts->done[ position[g] ] ) {
+                continue;
+            }
+            ts->done[ position[g] ] = true;
+            costs[ position[g] ] = cost;
+            ++ts->n_done;
+            if ( 'e' == kind && cost < atomic_load( &ts->best ) ) {
+                atomic_store( &ts->best, cost );
+                ts->best_guess = g;
+            }
+        }
+        fclose( f );
+        printf( "Resuming from %s: %d/%d first words already checked\n",
+                path, ts->n_done, ts->n_ranked );
+    }
+
+    char temporary[FILENAME_MAX];
+    snprintf( temporary, FILENAME_MAX, "%s.tmp", path );
+    ts->checkpoint = fopen( temporary, "w" );
+    if ( NULL == ts->checkpoint ) {
+        printf( "wordle: failed to create checkpoint file %s\n", temporary );
+        exit(1);
+    }
+    fprintf( ts->checkpoint, CHECKPOINT_HEADER " %d %llx %d\n", ts->n_words,
+             (unsigned long long)checksum, MAX_TRIES );
+    for ( int r = 0; r < ts->n_ranked; ++r ) {
+        if ( ts->done[r] ) {    // only the best cost is needed as exact
+            int g = ts->ranked[r].guess;
+            fprintf( ts->checkpoint, "%s %d %c\n", get_nth_word_in_dictionary( g ),
+                     costs[r], ( g == ts->best_guess ) ? 'e' : 'b' );
+        }
+    }
+    if ( 0 != fflush( ts->checkpoint ) || 0 != fsync( fileno( ts->checkpoint ) ) ||
+         0 != rename( temporary, path ) ) {
+        printf( "wordle: failed to write checkpoint file %s\n", path );
+        exit(1);
+    }
+    free( costs );
+    free( position );
+}
+
+typedef struct {
+    search_worker   *sw;
+    tree_node       *nodes;
+    int             n_nodes, max_nodes;
+    tree_edge       *edges;
+    int             n_edges, max_edges;
+} tree_builder;
+
+// add the node trying guess for the n words with depth tries left, and all
+// its children, and return its index.
+static int add_tree_node( tree_builder *tb, const int *words, int n, int depth,
+                          int guess )
+{
+    if ( tb->n_nodes == tb->max_nodes ) {
+        tb->max_nodes *= 2;
+        tb->nodes = realloc( tb->nodes, sizeof( tree_node ) * tb->max_nodes );
+        assert( tb->nodes );
+    }
+    int node = tb->n_nodes++;
+    tb->nodes[node].guess = (uint32_t)guess;
+
+    int *buckets = malloc( sizeof( int ) * n );
+    uint8_t *patterns = malloc( n );
+    assert( buckets && patterns );
+    int start[N_PATTERNS+1];
+    split_words( guess, words, n, patterns, buckets, start );
+    int n_edges = 0;
+    for ( int p = 0; p < WINNING_PATTERN; ++p ) {
+        n_edges += ( start[p+1] != start[p] );
+    }
+    while ( tb->n_edges + n_edges > tb->max_edges ) {
+        tb->max_edges *= 2;
+        tb->edges = realloc( tb->edges, sizeof( tree_edge ) * tb->max_edges );
+        assert( tb->edges );
+    }
+    int edge = tb->n_edges;
+    tb->nodes[node].first_edge = (uint32_t)edge;
+    tb->nodes[node].n_edges = (uint32_t)n_edges;
+    tb->n_edges += n_edges;
+
+    for ( int p = 0; p < WINNING_PATTERN; ++p ) {
+        int c = start[p+1] - start[p];
+        if ( 0 == c ) {
+            continue;
+        }
+        int child_guess = -1;
+        int cost = search_words( tb->sw, &buckets[start[p]], c, depth - 1,
+                                 NO_TREE, &child_guess );
+        assert( cost < NO_TREE && -1 != child_guess );
+        (void)cost;
+        int child = add_tree_node( tb, &buckets[start[p]], c, depth - 1,
+                                   child_guess );
+        tb->edges[edge].pattern = (uint32_t)p;
+        tb->edges[edge].child = (uint32_t)child;
+        ++edge;
+    }
+    free( patterns );
+    free( buckets );
+    return node;
+}
+
+static void write_tree( const char *path, const tree_builder *tb, int cost )
+{
+    tree_file_header h;
+    memset( &h, 0, sizeof( h ) );
+    memcpy( h.magic, TREE_FILE_MAGIC, sizeof( h.magic ) );
+    h.version = TREE_FILE_VERSION;
+    h.byte_order = TREE_BYTE_ORDER;
+    h.n_words = (uint32_t)get_dictionary_size();
+    h.n_nodes = (uint32_t)tb->n_nodes;
+    h.n_edges = (uint32_t)tb->n_edges;
+    h.cost = (uint32_t)cost;
+    h.dictionary = get_dictionary_checksum();
+
+    FILE *f = fopen( path, "wb" );
+    if ( NULL == f ) {
+        printf( "wordle: failed to create tree file %s\n", path );
+        exit(1);
+    }
+    if ( 1 != fwrite( &h, sizeof( h ), 1, f ) ||
+         (size_t)tb->n_nodes != fwrite( tb->nodes, sizeof( tree_node ), tb->n_nodes, f ) ||
+         (size_t)tb->n_edges != fwrite( tb->edges, sizeof( tree_edge ), tb->n_edges, f ) ||
+         0 != fclose( f ) ) {
+        printf( "wordle: failed to write tree file %s\n", path );
+        exit(1);
+    }
+}
+
+static void init_search_worker( search_worker *sw, int n_words )
+{
+    for ( int d = 0; d <= MAX_TRIES; ++d ) {
+        sw->level[d].ranked = malloc( sizeof( ranked_guess ) * n_words );
+        sw->level[d].buckets = malloc( sizeof( int ) * n_words );
+        sw->level[d].patterns = malloc( n_words );
+        assert( sw->level[d].ranked && sw->level[d].buckets && sw->level[d].patterns );
+    }
+}
+
+static void discard_search_worker( search_worker *sw )
+{
+    for ( int d = 0; d <= MAX_TRIES; ++d ) {
+        free( sw->level[d].ranked );
+        free( sw->level[d].buckets );
+        free( sw->level[d].patterns );
+    }
+}
+
+extern void build_decision_tree( const char *path, const char *checkpoint,
+                                 thread_pool *tp )
+{
+    assert( NO_MATRIX != get_feedback_matrix_type() );
+    init_memo( );
+
+    tree_search ts;
+    ts.n_words = get_dictionary_size();
+    ts.words = malloc( sizeof( int ) * ts.n_words );
+    assert( ts.words );
+    for ( int i = 0; i < ts.n_words; ++i ) {
+        ts.words[i] = i;
+    }
+    int n_workers = get_thread_pool_size( tp );
+    ts.workers = malloc( sizeof( search_worker ) * n_workers );
+    assert( ts.workers );
+    for ( int w = 0; w < n_workers; ++w ) {
+        init_search_worker( &ts.workers[w], ts.n_words );
+    }
+    ts.ranked = malloc( sizeof( ranked_guess ) * ts.n_words );
+    assert( ts.ranked );
+    ts.n_ranked = rank_guesses( ts.n_words, ts.words, ts.n_words, MAX_TRIES,
+                                NO_TREE, ts.ranked );
+    ts.done = calloc( ts.n_ranked + 1, sizeof( bool ) );
+    assert( ts.done );
+    ts.n_done = 0;
+    atomic_init( &ts.best, NO_TREE );
+    ts.best_guess = -1;
+    pthread_mutex_init( &ts.lock, NULL );
+
+    open_checkpoint( &ts, checkpoint );
+    run_in_thread_pool( tp, ts.n_ranked, 1, search_first_guesses, &ts );
+    fclose( ts.checkpoint );
+
+    if ( -1 == ts.best_guess ) {
+        printf( "wordle: no strategy finds all words in %d tries\n", MAX_TRIES );
+        exit(1);
+    }
+    int cost = atomic_load( &ts.best );
+    tree_builder tb = { &ts.workers[0], NULL, 0, 64, NULL, 0, 64 };
+    tb.nodes = malloc( sizeof( tree_node ) * tb.max_nodes );
+    tb.edges = malloc( sizeof( tree_edge ) * tb.max_edges );
+    assert( tb.nodes && tb.edges );
+    add_tree_node( &tb, ts.words, ts.n_words, MAX_TRIES, ts.best_guess );
+    write_tree( path, &tb, cost );
+    remove( checkpoint );
+    printf( "Decision tree starting with %s: %d tries for %d words (%.4f average), "
+            "%d nodes written in %s\n", get_nth_word_in_dictionary( ts.best_guess ),
+            cost, ts.n_words, (double)cost / ts.n_words, tb.n_nodes, path );
+
+    free( tb.edges );
+    free( tb.nodes );
+    pthread_mutex_destroy( &ts.lock );
+    free( ts.done );
+    free( ts.ranked );
+    for ( int w = 0; w < n_workers; ++w ) {
+        discard_search_worker( &ts.workers[w] );
+    }
+    free( ts.workers );
+    free( ts.words );
+    discard_memo( );
+}
+
+extern void load_decision_tree( const char *path )
+{
+    discard_decision_tree( );
+    FILE *f = fopen( path, "rb" );
+    if ( NULL == f ) {
+        printf( "wordle: unable to open tree file %s\n", path );
+        exit(1);
+    }
+    fseek( f, 0, SEEK_END );
+    long size = ftell( f );
+    rewind( f );
+    if ( size < (long)sizeof( tree_file_header ) ) {
+        printf( "wordle: invalid tree file %s\n", path );
+        exit(1);
+    }
+    t_tree = malloc( size );
+    assert( t_tree );
+    if ( 1 != fread( t_tree, size, 1, f ) ) {
+        printf( "wordle: failed to read tree file %s\n", path );
+        exit(1);
+    }
+    fclose( f );
+
+    const tree_file_header *h = (const tree_file_header *)t_tree;
+    if ( 0 != memcmp( h->magic, TREE_FILE_MAGIC, sizeof( h->magic ) ) ||
+         h->version != TREE_FILE_VERSION || h->byte_order != TREE_BYTE_ORDER ||
+         h->n_nodes == 0 || (uint64_t)size != sizeof( tree_file_header ) +
+                                    (uint64_t)h->n_nodes * sizeof( tree_node ) +
+                                    (uint64_t)h->n_edges * sizeof( tree_edge ) ) {
+        printf( "wordle: incompatible or truncated tree file %s\n", path );
+        exit(1);
+    }
+    if ( h->n_words != (uint32_t)get_dictionary_size() ||
+         h->dictionary != get_dictionary_checksum() ) {
+        printf( "wordle: tree file %s does not match the dictionary\n", path );
+        exit(1);
+    }
+    t_nodes = (const tree_node *)&t_tree[sizeof( tree_file_header )];
+    t_edges = (const tree_edge *)&t_nodes[h->n_nodes];
+    for ( uint32_t i = 0; i < h->n_nodes; ++i ) {
+        if ( t_nodes[i].guess >= h->n_words ||
+             t_nodes[i].first_edge > h->n_edges ||
+             t_nodes[i].n_edges > h->n_edges - t_nodes[i].first_edge ) {
+            printf( "wordle: corrupted tree file %s\n", path );
+            exit(1);
+        }
+    }
+    for ( uint32_t i = 0; i < h->n_edges; ++i ) {
+        if ( t_edges[i].pattern >= WINNING_PATTERN || t_edges[i].child >= h->n_nodes ) {
+            printf( "wordle: corrupted tree file %s\n", path );
+            exit(1);
+        }
+    }
+}
+
+extern const char *get_decision_tree_word( const char *data )
+{
+    if ( NULL == t_nodes || 0 != strlen( data ) % ( 2 * WORD_SIZE ) ) {
+        return NULL;
+    }
+
+    const tree_node *node = t_nodes;
+    for ( ; *data; data += 2 * WORD_SIZE ) {
+        char word[WORD_SIZE+1];
+        uint8_t pattern;
+        if ( ! get_pattern_from_data( data, word, &pattern ) ||
+             0 != strcmp( word, get_nth_word_in_dictionary( node->guess ) ) ) {
+            return NULL;
+        }
+
+        // binary search in the node edges
+        const tree_edge *edges = &t_edges[node->first_edge];
+        int low = 0, high = (int)node->n_edges - 1;
+        while ( low <= high && edges[(low + high) / 2].pattern != pattern ) {
+            if ( edges[(low + high) / 2].pattern < pattern ) {
+                low = (low + high) / 2 + 1;
+            } else {
+                high = (low + high) / 2 - 1;
+            }
+        }
+        if ( low > high ) {     // including the winning pattern
+            return NULL;
+        }
+        node = &t_nodes[ edges[(low + high) / 2].child ];
+    }
+    return get_nth_word_in_dictionary( node->guess );
+}
+
+extern void discard_decision_tree( void )
+{
+    free( t_tree );
+    t_tree = NULL;
+    t_nodes = NULL;
+    t_edges = NULL;
+}
@@ -0,0 +1,40 @@
+
+#ifndef __WTREE_H__
+#define __WTREE_H__
+
+#include <stdbool.h>
+#include "wordle.h"
+#include "wpool.h"
+
+// A decision tree is a complete strategy to find any word in the dictionary:
+// each node gives the word to try, and the feedback pattern (see wpos.h)
+// obtained with that word selects the next node. The tree built by
+// build_decision_tree is optimal: it minimizes the total number of tries
+// needed to find every word in the dictionary, that is the average number of
+// tries, without ever needing more than MAX_TRIES tries.
+
+// search the optimal decision tree for the currently loaded dictionary, using
+// the given thread pool (or the calling thread only if tp is NULL), and write
+// it in the given file. The feedback matrix must have been initialized before
+// (see wmatrix.h). The search can take hours with a large dictionary: its
+// progress is written in the checkpoint file, and if the checkpoint file
+// already exists, the search resumes from where it stopped. The checkpoint
+// file is removed once the tree is written.
+extern void build_decision_tree( const char *path, const char *checkpoint,
+                                 thread_pool *tp );
+
+// load a decision tree written by build_decision_tree. The dictionary used
+// to build the tree must be loaded before.
+extern void load_decision_tree( const char *path );
+
+// return the word to try according to the decision tree, given the previous
+// attempts as a data string (see wsolve.h), or NULL if the data string does
+// not follow the tree (a word that was not suggested by the tree, or a
+// pattern that no word in dictionary can give) or if the word is already
+// found. An empty data string gives the first word to try.
+extern const char *get_decision_tree_word( const char *data );
+
+// free the decision tree
+extern void discard_decision_tree( void );
+
+#endif /* __WTREE_H__ */